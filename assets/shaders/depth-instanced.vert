@@ -0,0 +1,18 @@
+#version 330
+
+// The camera data shared by all the shaders (uploaded once per frame by the renderer, see "uniform-blocks.hpp")
+layout(std140) uniform Frame {
+    mat4 VP;        // View-projection matrix
+    vec3 eye;       // Eye position (camera position)
+};
+
+layout(location=0) in vec3 position;      // Vertex position input
+layout(location=4) in mat4 M;             // Model matrix of the instance (locations 4 to 7)
+
+// The position must be computed exactly like "lighted-instanced.vert" does (see "depth.vert")
+invariant gl_Position;
+
+void main(){
+    vec3 world = (M * vec4(position, 1.0)).xyz;     // Transform vertex position to world space
+    gl_Position = VP * vec4(world, 1.0);            // Transform vertex position to clip space
+}
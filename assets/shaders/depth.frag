@@ -0,0 +1,5 @@
+#version 330
+
+// The depth pre-pass only writes the depth buffer, so there is nothing to output
+void main(){
+}
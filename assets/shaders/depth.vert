@@ -0,0 +1,20 @@
+#version 330
+
+// The camera data shared by all the shaders (uploaded once per frame by the renderer, see "uniform-blocks.hpp")
+layout(std140) uniform Frame {
+    mat4 VP;        // View-projection matrix
+    vec3 eye;       // Eye position (camera position)
+};
+
+uniform mat4 M;      // Model matrix
+
+layout(location=0) in vec3 position;      // Vertex position input
+
+// The depth pre-pass is followed by a pass that only draws the pixels whose depth is EQUAL to the stored one,
+// so the position must be computed exactly like "lighted.vert" does (same expression and "invariant" in both shaders)
+invariant gl_Position;
+
+void main(){
+    vec3 world = (M * vec4(position, 1.0)).xyz;     // Transform vertex position to world space
+    gl_Position = VP * vec4(world, 1.0);            // Transform vertex position to clip space
+}
@@ -1,6 +1,7 @@
 #version 330
 
-#define MAX_LIGHTS 16
+#define MAX_LIGHTS 64
+#define MAX_OBJECT_LIGHTS 8
 
 #define DIRECTIONAL 0
 #define POINT 1
@@ -17,9 +18,72 @@ struct Light {
     vec2 cone_angles;   // Cone angles (x: inner angle, y: outer angle) for spotlights
 };
 
-// Array of lights
-uniform Light lights[MAX_LIGHTS];
-uniform int light_count;
+// Varying inputs from the vertex shader
+in Varyings {
+    vec4 color;         // Color of the fragment
+    vec2 tex_coord;     // Texture coordinates of the fragment
+    vec3 normal;        // Normal vector of the fragment
+    vec3 view;          // View vector (direction from fragment to camera)
+    vec3 world;         // World position of the fragment
+} fs_in;
+
+// Array of lights (uploaded once per frame by the renderer, see "uniform-blocks.hpp")
+// This is only used when clustered lighting is disabled
+layout(std140) uniform Lights {
+    Light lights[MAX_LIGHTS];
+    int light_count;
+};
+
+// The indices (in "lights") of the lights picked by the renderer for the current object
+uniform int object_lights[MAX_OBJECT_LIGHTS];
+uniform int object_light_count;
+
+// The camera data shared by all the shaders
+layout(std140) uniform Frame {
+    mat4 VP;        // View-projection matrix
+    vec3 eye;       // Eye position (camera position)
+};
+
+// The data needed to find the cluster of the fragment (see "light-clusters.hpp")
+layout(std140) uniform Clusters {
+    vec4 camera_forward;    // xyz: The forward direction of the camera
+    vec4 cluster_depth;     // x: near, y: far, z: scale and w: bias to get the slice from log(depth)
+    vec4 cluster_viewport;  // xy: origin and zw: size of the viewport in pixels
+    uvec4 cluster_grid;     // xyz: The number of clusters on each axis, w: The number of global lights
+    int clustered_lighting; // 0 means the lights are read from the Lights block instead
+};
+
+uniform samplerBuffer light_data;       // 5 texels per light
+uniform usamplerBuffer cluster_data;    // The offset and count of the lights of each cluster in light_indices
+uniform usamplerBuffer light_indices;   // The indices of the lights of every cluster
+
+// Reads a light from light_data (the layout must match "LightClusters::pushLightData")
+Light fetch_light(int index){
+    int base = index * 5;
+    vec4 texel0 = texelFetch(light_data, base);
+    vec4 texel1 = texelFetch(light_data, base + 1);
+    vec4 texel2 = texelFetch(light_data, base + 2);
+    vec4 texel3 = texelFetch(light_data, base + 3);
+    vec4 texel4 = texelFetch(light_data, base + 4);
+    Light light;
+    light.type = int(texel0.w);
+    light.position = texel0.xyz;
+    light.direction = texel1.xyz;
+    light.diffuse = texel2.rgb;
+    light.specular = texel3.rgb;
+    light.attenuation = texel4.xyz;
+    light.cone_angles = vec2(texel1.w, texel2.w);
+    return light;
+}
+
+// Returns the index of the cluster containing the current fragment
+int find_cluster(){
+    vec2 screen = clamp((gl_FragCoord.xy - cluster_viewport.xy) / cluster_viewport.zw, 0.0, 0.9999);
+    uvec2 tile = uvec2(screen * vec2(cluster_grid.xy));
+    float depth = max(dot(fs_in.world - eye, camera_forward.xyz), cluster_depth.x);
+    uint slice = uint(clamp(floor(log(depth) * cluster_depth.z + cluster_depth.w), 0.0, float(cluster_grid.z - 1u)));
+    return int((slice * cluster_grid.y + tile.y) * cluster_grid.x + tile.x);
+}
 
 // Struct to represent the sky
 struct Sky {
@@ -39,29 +103,61 @@ struct Material {
 
 uniform Material material;
 
-// Varying inputs from the vertex shader
-in Varyings {
-    vec4 color;         // Color of the fragment
-    vec2 tex_coord;     // Texture coordinates of the fragment
-    vec3 normal;        // Normal vector of the fragment
-    vec3 view;          // View vector (direction from fragment to camera)
-    vec3 world;         // World position of the fragment
-} fs_in;
-
 // Output color of the fragment
 out vec4 frag_color;
 
+// Shared between the main function and "shade_light"
+vec3 view;
+vec3 normal;
+vec3 material_diffuse;
+vec3 material_specular;
+float material_shininess;
+
+// Returns the diffuse and specular light reflected from the given light
+vec3 shade_light(Light light){
+    vec3 direction_to_light = -light.direction;
+    if(light.type != DIRECTIONAL){
+        // For non-directional lights, compute the direction to the light from the fragment
+        direction_to_light = normalize(light.position - fs_in.world);
+    }
+    
+    // Compute the diffuse reflection
+    vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
+    
+    // Compute the reflected direction for specular reflection
+    vec3 reflected = reflect(-direction_to_light, normal);
+    
+    // Compute the specular reflection
+    vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
+
+    float attenuation = 1;
+    if(light.type != DIRECTIONAL){
+        // For non-directional lights, compute attenuation based on distance
+        float d = distance(light.position, fs_in.world);
+        attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
+        
+        if(light.type == SPOT){
+            // For spotlights, attenuate based on the cone angles
+            float angle = acos(dot(-direction_to_light, light.direction));
+            attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle);
+        }
+    }
+
+    // Accumulate the diffuse and specular components with attenuation
+    return (diffuse + specular) * attenuation;
+}
+
 void main(){
-    vec3 view = normalize(fs_in.view);
-    vec3 normal = normalize(fs_in.normal);
+    view = normalize(fs_in.view);
+    normal = normalize(fs_in.normal);
 
     // Retrieve material properties from textures
-    vec3 material_diffuse = texture(material.albedo, fs_in.tex_coord).rgb;
-    vec3 material_specular = texture(material.specular, fs_in.tex_coord).rgb;
+    material_diffuse = texture(material.albedo, fs_in.tex_coord).rgb;
+    material_specular = texture(material.specular, fs_in.tex_coord).rgb;
     vec3 material_ambient = material_diffuse * texture(material.ambient_occlusion, fs_in.tex_coord).r;
     
     float material_roughness = texture(material.roughness, fs_in.tex_coord).r;
-    float material_shininess = 2.0 / pow(clamp(material_roughness, 0.001, 0.999), 4.0) - 2.0;
+    material_shininess = 2.0 / pow(clamp(material_roughness, 0.001, 0.999), 4.0) - 2.0;
 
     vec3 material_emissive = texture(material.emissive, fs_in.tex_coord).rgb;
 
@@ -73,42 +169,23 @@ void main(){
     // Set the initial fragment color as the sum of emissive and ambient components
     frag_color = vec4(material_emissive + material_ambient, 1.0);
 
-    // Clamp the number of lights to the maximum allowed
-    int clamped_light_count = min(MAX_LIGHTS, light_count);
-
-    // Iterate through the lights
-    for(int i = 0; i < clamped_light_count; i++){
-        Light light = lights[i];
-
-        vec3 direction_to_light = -light.direction;
-        if(light.type != DIRECTIONAL){
-            // For non-directional lights, compute the direction to the light from the fragment
-            direction_to_light = normalize(light.position - fs_in.world);
+    if(clustered_lighting != 0){
+        // The global lights (e.g. directional lights) affect every fragment
+        for(int i = 0; i < int(cluster_grid.w); i++){
+            frag_color.rgb += shade_light(fetch_light(i));
         }
-        
-        // Compute the diffuse reflection
-        vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
-        
-        // Compute the reflected direction for specular reflection
-        vec3 reflected = reflect(-direction_to_light, normal);
-        
-        // Compute the specular reflection
-        vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
-
-        float attenuation = 1;
-        if(light.type != DIRECTIONAL){
-            // For non-directional lights, compute attenuation based on distance
-            float d = distance(light.position, fs_in.world);
-            attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
-            
-            if(light.type == SPOT){
-                // For spotlights, attenuate based on the cone angles
-                float angle = acos(dot(-direction_to_light, light.direction));
-                attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle);
-            }
+        // Then we only loop over the lights whose range touches our cluster
+        uvec2 range = texelFetch(cluster_data, find_cluster()).xy;
+        for(uint i = 0u; i < range.y; i++){
+            frag_color.rgb += shade_light(fetch_light(int(texelFetch(light_indices, int(range.x + i)).r)));
         }
+    } else {
+        // Clamp the number of lights to the maximum allowed
+        int clamped_light_count = min(MAX_OBJECT_LIGHTS, object_light_count);
 
-        // Accumulate the diffuse and specular components with attenuation
-        frag_color.rgb += (diffuse + specular) * attenuation;
+        // Iterate through the lights that affect this object
+        for(int i = 0; i < clamped_light_count; i++){
+            frag_color.rgb += shade_light(lights[object_lights[i]]);
+        }
     }
 }
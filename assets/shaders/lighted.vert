@@ -1,7 +1,11 @@
 #version 330
 
-uniform vec3 eye;    // Eye position (camera position)
-uniform mat4 VP;     // View-projection matrix
+// The camera data shared by all the shaders (uploaded once per frame by the renderer, see "uniform-blocks.hpp")
+layout(std140) uniform Frame {
+    mat4 VP;        // View-projection matrix
+    vec3 eye;       // Eye position (camera position)
+};
+
 uniform mat4 M;      // Model matrix
 uniform mat4 M_IT;   // Inverse-transpose of the model matrix
 
@@ -18,6 +22,9 @@ out Varyings {
     vec3 world;         // Output world position of the vertex
 } vs_out;
 
+// The position must match the one computed by the depth pre-pass (see "depth.vert")
+invariant gl_Position;
+
 void main(){
     vec3 world = (M * vec4(position, 1.0)).xyz;     // Transform vertex position to world space
     gl_Position = VP * vec4(world, 1.0);            // Transform vertex position to clip space
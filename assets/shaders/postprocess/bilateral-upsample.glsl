@@ -0,0 +1,28 @@
+// The depth-aware upsample used by the postprocess chain (see "postprocess-chain.hpp")
+// A low resolution effect result is stretched over the full resolution. Plain bilinear filtering would blend the
+// results of the foreground and the background along the edges of the objects (making them bleed into each other),
+// so every one of the 4 nearest low resolution texels is also weighted by how close its depth is to the depth of the
+// pixel. The depth of a low resolution texel is read from the full resolution depth at its center.
+// The depth is not linear, so SHARPNESS is tuned for the depth differences between the objects and what is behind them.
+// A texel too different from all the others still keeps a tiny weight, so a thin object falls back to bilinear filtering.
+vec4 upsample(sampler2D tex, sampler2D depth, vec2 uv){
+    const float SHARPNESS = 1000.0;
+    const float MIN_WEIGHT = 1e-3;
+    vec2 low_size = vec2(textureSize(tex, 0));
+    vec2 position = uv * low_size - 0.5;
+    vec2 base = floor(position);
+    vec2 fraction = position - base;
+    float pixel_depth = texture(depth, uv).r;
+    vec4 sum = vec4(0.0);
+    float total = 0.0;
+    for(int i = 0; i < 4; i++){
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec2 texel_uv = (base + offset + 0.5) / low_size;
+        vec2 bilinear = mix(1.0 - fraction, fraction, offset);
+        float similarity = max(exp(-SHARPNESS * abs(texture(depth, texel_uv).r - pixel_depth)), MIN_WEIGHT);
+        float weight = bilinear.x * bilinear.y * similarity;
+        sum += texture(tex, texel_uv) * weight;
+        total += weight;
+    }
+    return sum / total;
+}
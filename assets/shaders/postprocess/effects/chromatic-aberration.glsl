@@ -0,0 +1,13 @@
+// A sampling effect reads its input at other pixels, so it is written as "vec4 apply(sampler2D tex, vec2 uv)"
+// and it starts a new pass (the pointwise effects after it are fused into the same pass)
+
+// Chromatic aberration mimics some old cameras where the lens disperses light differently based on its wavelength
+// The green channel is read from the pixel itself while the red and blue channels are read from the pixels
+// that are STRENGTH to the left and to the right of it (in the texture space)
+vec4 apply(sampler2D tex, vec2 uv){
+    const float STRENGTH = 0.005;
+    float g = texture(tex, uv).g;
+    float r = texture(tex, vec2(uv.x - STRENGTH, uv.y)).r;
+    float b = texture(tex, vec2(uv.x + STRENGTH, uv.y)).b;
+    return vec4(r, g, b, 1.0);
+}
@@ -0,0 +1,11 @@
+// Distortion is a sampling effect (see "chromatic-aberration.glsl") that makes the scene look like it is under water
+// The pixels are moved by the (random looking) colors of "additional_sampler" (given in the config of the effect)
+uniform sampler2D additional_sampler;
+// This controls how much the texture coordinates will be distorted. 0 means no distortion.
+uniform float effect_power = 0.05;
+
+vec4 apply(sampler2D tex, vec2 uv){
+    // Make the value's mean = 0 so that the pixels move in every direction
+    vec2 distortion = (texture(additional_sampler, uv).xy - 0.5) * effect_power;
+    return texture(tex, uv + distortion);
+}
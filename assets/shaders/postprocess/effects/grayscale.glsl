@@ -0,0 +1,10 @@
+// Postprocess effect snippets are combined by the engine into fused fragment shaders (see "postprocess-chain.hpp")
+// A pointwise effect only needs the color of its own pixel, so it is written as "vec4 apply(vec4 color, vec2 uv)"
+// and many pointwise effects can be applied one after the other in the same pass
+
+// To apply the grayscale effect, we compute the average of the red/blue/green channels
+// and set that average value to all the channels
+vec4 apply(vec4 color, vec2 uv){
+    float gray = dot(color.rgb, vec3(1.0/3.0, 1.0/3.0, 1.0/3.0));
+    return vec4(vec3(gray), color.a);
+}
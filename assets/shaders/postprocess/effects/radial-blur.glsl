@@ -0,0 +1,12 @@
+// Radial blur is a sampling effect (see "chromatic-aberration.glsl")
+// It averages STEPS pixels along the direction going outward from the center of the screen
+vec4 apply(sampler2D tex, vec2 uv){
+    const int STEPS = 16;
+    const float STRENGTH = 0.2;
+    vec2 step_vector = (uv - 0.5) * (STRENGTH / STEPS);
+    vec4 sum = vec4(0.0);
+    for(int i = 0; i < STEPS; i++){
+        sum += texture(tex, uv + step_vector * i);
+    }
+    return sum / STEPS;
+}
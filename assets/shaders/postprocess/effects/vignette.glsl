@@ -0,0 +1,8 @@
+// Vignette is a pointwise effect (see "grayscale.glsl") that darkens the corners of the screen
+// to grab the attention of the viewer towards the center of the screen
+
+vec4 apply(vec4 color, vec2 uv){
+    // Divide the scene color by 1 + the squared length of the pixel location in the NDC space
+    vec2 ndc = uv * 2.0 - 1.0;
+    return color / (1.0 + dot(ndc, ndc));
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+// The model matrix is read per instance from the instance buffer (a mat4 takes locations 4 to 7)
+layout(location = 4) in mat4 M;
+
+out Varyings {
+    vec4 color;
+} vs_out;
+
+// Since the model matrix differs between instances, we only need the view-projection matrix of the camera
+// which is shared by all the shaders in a uniform block (uploaded once per frame by the renderer)
+layout(std140) uniform Frame {
+    mat4 VP;
+    vec3 eye;
+};
+
+void main(){
+    gl_Position = VP * M * vec4(position, 1.0);
+    vs_out.color = color;
+}
@@ -1,9 +1,15 @@
-param([string[]] $tests)
+param([string[]] $tests, [switch] $headless)
+
+# With -headless, the tests run without a window (see "-H" in "source/main.cpp")
+$headlessArgs = @()
+if($headless){
+    $headlessArgs = @("-H")
+}
 
 function Invoke-Tests {
     param([string[]] $configs)
     foreach ($config in $configs){
-        ./bin/GAME_APPLICATION -f=2 -c="$config"
+        ./bin/GAME_APPLICATION -f=2 -c="$config" @headlessArgs
     }
 }
 
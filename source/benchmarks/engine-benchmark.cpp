@@ -0,0 +1,327 @@
+// Measures the hot paths of the engine and writes the results as JSON so they can be compared between commits.
+// Every benchmark runs its operation in batches whose size is picked so a batch takes a measurable time, then the
+// median time per operation of a few batches is reported (in the format of Google Benchmark's JSON output).
+// The benchmarks that create OpenGL objects (loading meshes and the renderer) need a headless context
+// (see "headless-context.hpp"), and they are skipped if none can be created.
+// Usage: GFX_BENCH [-o=gfx-bench.json] [-filter=substring] [-min-time=seconds] [-H=egl|osmesa]
+// The progress is printed to the console (along with the warnings of the loaders), so the results always go to a file.
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <flags/flags.h>
+#include <json/json.hpp>
+
+#include <application.hpp>
+#include <headless-context.hpp>
+#include <job-system.hpp>
+#include <asset-loader.hpp>
+#include <ecs/world.hpp>
+#include <components/camera.hpp>
+#include <components/movement.hpp>
+#include <components/mesh-renderer.hpp>
+#include <mesh/mesh-utils.hpp>
+#include <systems/forward-renderer.hpp>
+#include <systems/transparent-sorter.hpp>
+#include <systems/free-camera-controller.hpp>
+#include <systems/scarecrow-controller.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+    // The operations write their results here so the compiler can't remove them
+    volatile float sink;
+
+    // A batch runs the operation "iterations" times and returns the time it measured in nanoseconds
+    // (so every benchmark can leave its setup out of the measured time)
+    using Batch = std::function<double(size_t iterations)>;
+
+    struct Settings {
+        std::string filter;
+        double minTime = 0.5;   // The time (in seconds) spent measuring every benchmark
+        int repetitions = 5;
+    };
+
+    Settings settings;
+    nlohmann::json results = nlohmann::json::array();
+
+    void benchmark(const std::string& name, const Batch& batch) {
+        if(name.find(settings.filter) == std::string::npos) return;
+        // Double the iterations till a batch takes a measurable part of the time
+        double batchTime = settings.minTime / settings.repetitions * 1e9;
+        size_t iterations = 1;
+        double time = batch(iterations);
+        while(time < batchTime * 0.5 && iterations < (size_t(1) << 30)) {
+            iterations *= 2;
+            time = batch(iterations);
+        }
+        std::vector<double> times;
+        for(int repetition = 0; repetition < settings.repetitions; repetition++)
+            times.push_back(batch(iterations) / iterations);
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        results.push_back({
+            {"name", name},
+            {"iterations", iterations},
+            {"repetitions", settings.repetitions},
+            {"real_time", median},
+            {"min_time", times.front()},
+            {"max_time", times.back()},
+            {"time_unit", "ns"}
+        });
+        std::cerr << name << ": " << median << " ns" << std::endl;
+    }
+
+    // Runs "operation(index)" for every iteration and measures the whole batch
+    template<typename Operation>
+    Batch loop(Operation operation) {
+        return [operation](size_t iterations) mutable {
+            auto start = Clock::now();
+            for(size_t index = 0; index < iterations; index++) operation(index);
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        };
+    }
+
+    // Makes a world of "count" entities spread over a square, where a "transparentRatio" of them are transparent
+    nlohmann::json generateWorld(size_t count, float transparentRatio, std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-50.0f, 50.0f), angle(0.0f, 360.0f), unit(0.0f, 1.0f);
+        nlohmann::json world = nlohmann::json::array();
+        world.push_back({{"position", {0, 1, 60}}, {"components", {{{"type", "Camera"}}}}});
+        for(size_t index = 0; index < count; index++) {
+            world.push_back({
+                {"name", "entity-" + std::to_string(index)},
+                {"position", {position(random), 0.0f, position(random)}},
+                {"rotation", {0.0f, angle(random), 0.0f}},
+                {"components", {
+                    {{"type", "Mesh Renderer"}, {"mesh", "cube"}, {"material", unit(random) < transparentRatio ? "glass" : "metal"}},
+                    {{"type", "Movement"}, {"linearVelocity", {0, 0, 0}}}
+                }}
+            });
+        }
+        return world;
+    }
+
+    // The assets used by the generated worlds
+    nlohmann::json generatedAssets() {
+        return nlohmann::json::parse(R"({
+            "shaders": {"tinted": {"vs": "assets/shaders/tinted.vert", "fs": "assets/shaders/tinted.frag"}},
+            "meshes": {"cube": "assets/models/cube.obj"},
+            "materials": {
+                "metal": {"type": "tinted", "shader": "tinted", "pipelineState": {"depthTesting": {"enabled": true}}, "tint": [0.5, 0.5, 0.5, 1]},
+                "glass": {"type": "tinted", "shader": "tinted", "transparent": true, "tint": [0.5, 0.5, 1, 0.5],
+                          "pipelineState": {"depthTesting": {"enabled": true}, "blending": {"enabled": true}, "depthMask": false}}
+            }
+        })");
+    }
+
+    void benchmarkTransforms(std::mt19937& random) {
+        std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+        std::vector<our::Transform> transforms(1024);
+        for(auto& transform : transforms) {
+            transform.position = {value(random), value(random), value(random)};
+            transform.rotation = {value(random), value(random), value(random)};
+            transform.scale = {1.0f, value(random), 1.0f};
+        }
+        benchmark("Transform::toMat4", loop([&](size_t index) {
+            sink = transforms[index & 1023].toMat4()[3][0];
+        }));
+    }
+
+    void benchmarkEntities() {
+        for(int depth : {1, 8, 32}) {
+            our::World world;
+            our::Entity* leaf = nullptr;
+            for(int level = 0; level < depth; level++) {
+                our::Entity* entity = world.add();
+                entity->parent = leaf;
+                entity->localTransform.position = glm::vec3(1, 0, 0);
+                entity->localTransform.rotation = glm::vec3(0, 0.1f, 0);
+                leaf = entity;
+            }
+            benchmark("Entity::getLocalToWorldMatrix/depth:" + std::to_string(depth), loop([&](size_t) {
+                sink = leaf->getLocalToWorldMatrix()[3][0];
+            }));
+        }
+        // The searched component is the last one, so every other component is tested before it
+        for(int count : {1, 4, 16}) {
+            our::World world;
+            our::Entity* entity = world.add();
+            for(int index = 1; index < count; index++) entity->addComponent<our::MovementComponent>();
+            entity->addComponent<our::CameraComponent>();
+            benchmark("Entity::getComponent/components:" + std::to_string(count), loop([&](size_t) {
+                sink = entity->getComponent<our::CameraComponent>()->fovY;
+            }));
+        }
+    }
+
+    void benchmarkDeserialization(const nlohmann::json& scene, std::mt19937& random) {
+        auto deserialize = [](const nlohmann::json& data) {
+            return [&data](size_t iterations) {
+                double time = 0.0;
+                for(size_t iteration = 0; iteration < iterations; iteration++) {
+                    our::World world;
+                    auto start = Clock::now();
+                    world.deserialize(data);
+                    time += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                }
+                return time;
+            };
+        };
+        if(scene.is_array()) benchmark("World::deserialize/app.jsonc", deserialize(scene));
+        for(size_t count : {1000, 10000}) {
+            nlohmann::json generated = generateWorld(count, 0.25f, random);
+            benchmark("World::deserialize/generated:" + std::to_string(count), deserialize(generated));
+        }
+    }
+
+    // Both routines walk every entity of the maze, so they are measured at random positions in the maze
+    void benchmarkCollisions(const nlohmann::json& scene, std::mt19937& random) {
+        if(!scene.is_array()) return;
+        our::Application application(nlohmann::json::object());
+        our::World world;
+        world.deserialize(scene);
+        std::uniform_real_distribution<float> x(-5.5f, 5.5f), z(-10.0f, 1.0f);
+        std::vector<glm::vec3> positions(256);
+        for(auto& position : positions) position = {x(random), 0.2f, z(random)};
+
+        our::FreeCameraControllerSystem cameraController;
+        cameraController.enter(&application);
+        benchmark("FreeCameraControllerSystem::iscollide/app.jsonc", loop([&](size_t index) {
+            sink = cameraController.iscollide(&world, positions[index & 255]);
+        }));
+        our::ScareCrowControllerSystem scarecrowController;
+        scarecrowController.enter(&application);
+        benchmark("ScareCrowControllerSystem::iscollide/app.jsonc", loop([&](size_t index) {
+            sink = (float)scarecrowController.iscollide(&world, positions[index & 255]);
+        }));
+    }
+
+    void benchmarkMeshLoading() {
+        std::vector<std::filesystem::path> models;
+        for(auto& file : std::filesystem::directory_iterator("assets/models")) {
+            std::string extension = file.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if(extension == ".obj") models.push_back(file.path());
+        }
+        std::sort(models.begin(), models.end());
+        for(auto& model : models) {
+            benchmark("mesh_utils::loadOBJ/" + model.filename().string(), [&](size_t iterations) {
+                double time = 0.0;
+                for(size_t iteration = 0; iteration < iterations; iteration++) {
+                    auto start = Clock::now();
+                    our::Mesh* mesh = our::mesh_utils::loadOBJ(model.string());
+                    time += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                    delete mesh;
+                }
+                return time;
+            });
+        }
+    }
+
+    void benchmarkRenderer(std::mt19937& random) {
+        our::deserializeAllAssets(generatedAssets());
+        for(size_t count : {1000, 10000}) {
+            our::World world;
+            world.deserialize(generateWorld(count, 0.25f, random));
+            our::ForwardRenderer renderer;
+            renderer.initialize({1280, 720}, nlohmann::json::object());
+            benchmark("ForwardRenderer::buildCommands/entities:" + std::to_string(count), loop([&](size_t) {
+                renderer.buildCommands(&world);
+                sink = (float)renderer.getTransparentCommandCount();
+            }));
+            renderer.destroy();
+        }
+        our::clearAllAssets();
+
+        // The sorter alone, on commands scattered like the generated worlds
+        for(size_t count : {1000, 10000}) {
+            std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+            std::vector<our::RenderCommand> extracted(count), commands;
+            for(size_t index = 0; index < count; index++) {
+                extracted[index].center = {position(random), 0.0f, position(random)};
+                extracted[index].id = (uint32_t)index;
+            }
+            our::TransparentSorter sorter;
+            benchmark("TransparentSorter::sort/commands:" + std::to_string(count), [&](size_t iterations) {
+                double time = 0.0;
+                for(size_t iteration = 0; iteration < iterations; iteration++) {
+                    commands = extracted;
+                    float angle = iteration * 0.01f;
+                    auto start = Clock::now();
+                    sorter.sort(commands, glm::vec3(0, 1, 60), glm::vec3(glm::sin(angle), 0, -glm::cos(angle)));
+                    time += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                }
+                return time;
+            });
+        }
+    }
+
+}
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    std::string outputPath = args.get<std::string>("o", "gfx-bench.json");
+    settings.filter = args.get<std::string>("filter", "");
+    settings.minTime = args.get<double>("min-time", 0.5);
+    std::string backend = args.get<std::string>("H", "");
+
+    // The real maze is read from the game config
+    nlohmann::json scene;
+    if(std::ifstream file("config/app.jsonc"); file) {
+        nlohmann::json config = nlohmann::json::parse(file, nullptr, true, true);
+        scene = config["scene"]["world"];
+    } else {
+        std::cerr << "Couldn't open config/app.jsonc, the benchmarks of the maze are skipped" << std::endl;
+    }
+
+    std::mt19937 random(42);
+    benchmarkTransforms(random);
+    benchmarkEntities();
+    benchmarkDeserialization(scene, random);
+    benchmarkCollisions(scene, random);
+
+    our::HeadlessContext context;
+    bool hasContext = context.create(backend, {64, 64});
+    std::string usedBackend = hasContext ? context.getBackend() : "none";
+    if(hasContext) {
+        benchmarkMeshLoading();
+        benchmarkRenderer(random);
+    } else {
+        std::cerr << "No OpenGL context, the benchmarks of the meshes and the renderer are skipped" << std::endl;
+    }
+    // The renderer starts the workers of the job system, so they are stopped before the context and before any return
+    our::JobSystem::shutdown();
+    if(hasContext) context.destroy();
+
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    nlohmann::json output = {
+        {"context", {
+            {"date", date},
+            {"executable", argv[0]},
+            {"num_cpus", std::thread::hardware_concurrency()},
+            {"opengl", usedBackend},
+#if defined(NDEBUG)
+            {"library_build_type", "release"}
+#else
+            {"library_build_type", "debug"}
+#endif
+        }},
+        {"benchmarks", results}
+    };
+    std::ofstream file(outputPath);
+    if(!file) {
+        std::cerr << "Couldn't open the output file: " << outputPath << std::endl;
+        return 1;
+    }
+    file << output.dump(2) << std::endl;
+    std::cerr << "Results saved to: " << outputPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Compares the ways of sorting the transparent commands from the farthest to the nearest:
+//  - The comparison sort the renderer used to do (std::sort with the dot products computed in every comparison)
+//  - The radix sort of the transparent sorter (without any order from the last frame)
+//  - The transparent sorter while the camera moves a little every frame (reusing the order of the last frame)
+// Usage: SORT_BENCH [-n frames] (the commands are random and the same for every method)
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <flags/flags.h>
+
+#include <systems/transparent-sorter.hpp>
+
+using Clock = std::chrono::steady_clock;
+
+// Makes "count" commands scattered in a box around the origin (their ids are their indices like extracted entities)
+static std::vector<our::RenderCommand> makeCommands(size_t count, std::mt19937& random) {
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::vector<our::RenderCommand> commands(count);
+    for(size_t index = 0; index < count; index++) {
+        commands[index].center = glm::vec3(position(random), position(random) * 0.1f, position(random));
+        commands[index].id = (uint32_t)index;
+        commands[index].mesh = nullptr;
+        commands[index].material = nullptr;
+    }
+    return commands;
+}
+
+// The camera walks slowly while turning, like a player does
+static void getCamera(int frame, glm::vec3& eye, glm::vec3& forward) {
+    float angle = frame * 0.01f;
+    eye = glm::vec3(frame * 0.05f, 1.0f, 0.0f);
+    forward = glm::vec3(glm::sin(angle), 0.0f, -glm::cos(angle));
+}
+
+// Returns true if the commands are sorted from the farthest to the nearest (up to the quantization of the keys)
+static bool isSorted(const std::vector<our::RenderCommand>& commands, const glm::vec3& forward) {
+    float tolerance = 200.0f / 65535.0f;
+    for(size_t index = 1; index < commands.size(); index++)
+        if(glm::dot(forward, commands[index].center) > glm::dot(forward, commands[index - 1].center) + tolerance) return false;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    flags::args args(argc, argv);
+    int frames = args.get<int>("n", 60);
+    std::mt19937 random(42);
+
+    std::cout << std::setw(10) << "commands" << std::setw(16) << "std::sort ms" << std::setw(16) << "radix ms"
+              << std::setw(16) << "coherent ms" << std::setw(12) << "coherent" << std::endl;
+    for(size_t count : {1000, 10000, 100000}) {
+        std::vector<our::RenderCommand> extracted = makeCommands(count, random), commands;
+        double times[3] = {0, 0, 0};
+        int coherentFrames = 0;
+        bool correct = true;
+        our::TransparentSorter radixSorter, coherentSorter;
+        for(int frame = 0; frame < frames; frame++) {
+            glm::vec3 eye, forward;
+            getCamera(frame, eye, forward);
+
+            // Every frame starts from the commands in the order they were extracted
+            commands = extracted;
+            auto start = Clock::now();
+            std::sort(commands.begin(), commands.end(), [forward](const our::RenderCommand& first, const our::RenderCommand& second) {
+                return glm::dot(forward, first.center) > glm::dot(forward, second.center);
+            });
+            times[0] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            auto sortRadix = [&]() {
+                commands = extracted;
+                radixSorter.reset();
+                auto start = Clock::now();
+                radixSorter.sort(commands, eye, forward);
+                times[1] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                correct = correct && isSorted(commands, forward);
+            };
+            auto sortCoherent = [&]() {
+                commands = extracted;
+                auto start = Clock::now();
+                coherentSorter.sort(commands, eye, forward);
+                times[2] += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                correct = correct && isSorted(commands, forward);
+                if(coherentSorter.wasCoherent()) coherentFrames++;
+            };
+            // The sort that runs later in a frame is slower (the caches hold the data of the one before it),
+            // so the two sorters take turns to be measured first
+            if(frame % 2 == 0) { sortRadix(); sortCoherent(); }
+            else { sortCoherent(); sortRadix(); }
+        }
+        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count;
+        for(double time : times) std::cout << std::setw(16) << time / frames;
+        std::cout << std::setw(8) << coherentFrames << "/" << frames << std::endl;
+        if(!correct) {
+            std::cerr << "ERROR: The transparent sorter didn't sort the commands" << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -26,6 +26,11 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "gl-state-cache.hpp"
+#include "job-system.hpp"
+#include "gpu-profiler.hpp"
+#include "flight-recorder.hpp"
+#include "stats-panel.hpp"
 
 std::string default_screenshot_filepath() {
     std::stringstream stream;
@@ -158,29 +163,36 @@ int our::Application::run(int run_for_frames) {
     // Set the function to call when an error occurs.
     glfwSetErrorCallback(glfw_error_callback);
 
-    // Initialize GLFW and exit if it failed
-    if(!glfwInit()){
-        std::cerr << "Failed to Initialize GLFW" << std::endl;
-        return -1;
-    }
+    auto win_config = getWindowConfiguration();             // Returns the WindowConfiguration current struct instance.
 
-    configureOpenGL(); // This function sets OpenGL window hints.
+    if(headless) {
+        // No window, the frames are drawn to a framebuffer of the window size (which also loads OpenGL)
+        if(!headlessContext.create(headlessBackend, {win_config.size.x, win_config.size.y})) return -1;
+        std::cout << "HEADLESS        : " << headlessContext.getBackend() << std::endl;
+    } else {
+        // Initialize GLFW and exit if it failed
+        if(!glfwInit()){
+            std::cerr << "Failed to Initialize GLFW" << std::endl;
+            return -1;
+        }
 
-    auto win_config = getWindowConfiguration();             // Returns the WindowConfiguration current struct instance.
+        configureOpenGL(); // This function sets OpenGL window hints.
+
+        // Create a window with the given "WindowConfiguration" attributes.
+        // If it should be fullscreen, monitor should point to one of the monitors (e.g. primary monitor), otherwise it should be null
+        GLFWmonitor* monitor = win_config.isFullscreen ? glfwGetPrimaryMonitor() : nullptr;
+        // The last parameter "share" can be used to share the resources (OpenGL objects) between multiple windows.
+        window = glfwCreateWindow(win_config.size.x, win_config.size.y, win_config.title.c_str(), monitor, nullptr);
+        if(!window) {
+            std::cerr << "Failed to Create Window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);         // Tell GLFW to make the context of our window the main context on the current thread.
 
-    // Create a window with the given "WindowConfiguration" attributes.
-    // If it should be fullscreen, monitor should point to one of the monitors (e.g. primary monitor), otherwise it should be null
-    GLFWmonitor* monitor = win_config.isFullscreen ? glfwGetPrimaryMonitor() : nullptr;
-    // The last parameter "share" can be used to share the resources (OpenGL objects) between multiple windows.
-    window = glfwCreateWindow(win_config.size.x, win_config.size.y, win_config.title.c_str(), monitor, nullptr);
-    if(!window) {
-        std::cerr << "Failed to Create Window" << std::endl;
-        glfwTerminate();
-        return -1;
+        gladLoadGL(glfwGetProcAddress);         // Load the OpenGL functions from the driver
     }
-    glfwMakeContextCurrent(window);         // Tell GLFW to make the context of our window the main context on the current thread.
-
-    gladLoadGL(glfwGetProcAddress);         // Load the OpenGL functions from the driver
+    our::GLStateCache::invalidate();        // We know nothing about the state of the new context yet
 
     // Print information about the OpenGL context
     std::cout << "VENDOR          : " << glGetString(GL_VENDOR) << std::endl;
@@ -199,9 +211,15 @@ int our::Application::run(int run_for_frames) {
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
 
-    setupCallbacks();
-    keyboard.enable(window);
-    mouse.enable(window);
+    if(window) {
+        setupCallbacks();
+        keyboard.enable(window);
+        mouse.enable(window);
+    } else {
+        // Without a window, nothing is ever pressed
+        keyboard.disable();
+        mouse.disable();
+    }
 
     // Start the ImGui context and set dark style (just my preference :D)
     IMGUI_CHECKVERSION();
@@ -209,10 +227,24 @@ int our::Application::run(int run_for_frames) {
     ImGuiIO& io = ImGui::GetIO();
     ImGui::StyleColorsDark();
 
-    // Initialize ImGui for GLFW and OpenGL
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    // Initialize ImGui for GLFW and OpenGL (without a window, we tell ImGui the size of the frames ourselves)
+    if(window) ImGui_ImplGlfw_InitForOpenGL(window, true);
+    else {
+        io.DisplaySize = ImVec2((float)win_config.size.x, (float)win_config.size.y);
+        io.IniFilename = nullptr; // There are no windows to remember the layout of
+    }
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
+    // The GPU profiler can show its panel from the start and write every measured time to a CSV file
+    imguiTimer.initialize({"ImGui"});
+    if(auto& profiler = app_config["profiler"]; profiler.is_object()) {
+        showProfiler = profiler.value("overlay", false);
+        if(profiler.contains("csv")) GPUProfiler::openCSV(profiler["csv"].get<std::string>());
+        showStats = profiler.value("stats", false);
+    }
+    // The flight recorder keeps the last frames and writes them when a frame goes over its budget
+    FlightRecorder::configure(app_config["flightRecorder"]);
+
     // This part of the code extracts the list of requested screenshots and puts them into a priority queue
     using ScreenshotRequest = std::pair<int, std::string>;
     std::priority_queue<
@@ -235,13 +267,21 @@ int our::Application::run(int run_for_frames) {
         currentState = nextState;
         nextState = nullptr;
     }
-    // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
-    if(currentState) currentState->onInitialize();
-
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
-    double last_frame_time = glfwGetTime();
     int current_frame = 0;
 
+    // The initialization of the first scene is counted as a part of the first frame by the CPU profiler
+    CPUProfiler::setThreadName("Main");
+    CPUProfiler::beginFrame(current_frame);
+    // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
+    if(currentState) {
+        PROFILE_SCOPE("State::onInitialize");
+        currentState->onInitialize();
+    }
+    // In headless mode, the time is the frame number multiplied by HEADLESS_DELTA_TIME
+    auto get_time = [&](){ return headless ? current_frame * HEADLESS_DELTA_TIME : glfwGetTime(); };
+    double last_frame_time = headless ? -HEADLESS_DELTA_TIME : get_time();
+
 
     std::unordered_map<std::string, ma_sound*> sounds; //All the music tracks that the program can run
     ma_sound* currentMusic = nullptr;
@@ -253,7 +293,8 @@ int our::Application::run(int run_for_frames) {
     ma_result result;
     ma_engine* pEngine = new ma_engine();
     
-    result = ma_engine_init(NULL, pEngine);
+    // There is nothing to hear in headless mode
+    result = headless ? MA_NO_BACKEND : ma_engine_init(NULL, pEngine);
     if (result == MA_SUCCESS) { //Succeeded to initialize the engine
         //Initializig the music tracks
         ma_sound_init_from_file(pEngine, "assets/music/Tamam.mp3", 0, NULL, NULL, sounds["menu"]);
@@ -264,25 +305,44 @@ int our::Application::run(int run_for_frames) {
     }
 
     //Game loop
-    while(!glfwWindowShouldClose(window)){
+    while(!closeRequested && !(window && glfwWindowShouldClose(window))){
 
 
 
 
         if(run_for_frames != 0 && current_frame >= run_for_frames) break;
-        glfwPollEvents(); // Read all the user events and call relevant callbacks.
+        // Start or finish the CPU trace if it is requested for this frame, then measure the whole frame
+        // The flight recorder and the stats panel read the counters of the last frame before they are reset for this one
+        CPUProfiler::beginFrame(current_frame);
+        FlightRecorder::beginFrame(current_frame);
+        StatsPanel::beginFrame();
+        FrameStats::beginFrame();
+        RECORD_ZONE("Application::frame");
+        if(window) glfwPollEvents(); // Read all the user events and call relevant callbacks.
+
+        // The GPU times of an older frame are ready now
+        GPUProfiler::nextFrame();
+        imguiTimer.beginFrame();
 
         // Start a new ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+        if(window) ImGui_ImplGlfw_NewFrame();
+        else io.DeltaTime = (float)HEADLESS_DELTA_TIME;
         ImGui::NewFrame();
 
-        if(currentState) currentState->onImmediateGui(); // Call to run any required Immediate GUI.
+        if(currentState) {
+            RECORD_ZONE("State::onImmediateGui");
+            currentState->onImmediateGui(); // Call to run any required Immediate GUI.
+        }
+        if(showProfiler) GPUProfiler::drawPanel(&showProfiler);
+        if(showStats) StatsPanel::drawPanel(&showStats);
 
         // If ImGui is using the mouse or keyboard, then we don't want the captured events to affect our keyboard and mouse objects.
         // For example, if you're focusing on an input and writing "W", the keyboard object shouldn't record this event.
-        keyboard.setEnabled(!io.WantCaptureKeyboard, window);
-        mouse.setEnabled(!io.WantCaptureMouse, window);
+        if(window) {
+            keyboard.setEnabled(!io.WantCaptureKeyboard, window);
+            mouse.setEnabled(!io.WantCaptureMouse, window);
+        }
 
         // Render the ImGui commands we called (this doesn't actually draw to the screen yet.
         ImGui::Render();
@@ -293,10 +353,13 @@ int our::Application::run(int run_for_frames) {
         glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
 
         // Get the current time (the time at which we are starting the current frame).
-        double current_frame_time = glfwGetTime();
+        double current_frame_time = get_time();
 
         // Call onDraw, in which we will draw the current frame, and send to it the time difference between the last and current frame
-        if(currentState) currentState->onDraw(current_frame_time - last_frame_time);
+        if(currentState) {
+            RECORD_ZONE("State::onDraw");
+            currentState->onDraw(current_frame_time - last_frame_time);
+        }
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
 
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
@@ -304,13 +367,24 @@ int our::Application::run(int run_for_frames) {
         glDisable(GL_DEBUG_OUTPUT);
         glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+        {
+            RECORD_ZONE("ImGui::render");
+            imguiTimer.begin(0);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+            imguiTimer.end();
+        }
+        // ImGui changes (then restores) the OpenGL state without going through our state cache, so we can't trust it anymore
+        our::GLStateCache::invalidate();
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Re-enable the debug messages
         glEnable(GL_DEBUG_OUTPUT);
         glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
 
+        // If F3 is pressed, show or hide the GPU profiler (and F4 does the same for the engine stats)
+        if(keyboard.justPressed(GLFW_KEY_F3)) showProfiler = !showProfiler;
+        if(keyboard.justPressed(GLFW_KEY_F4)) showStats = !showStats;
+
         // If F12 is pressed, take a screenshot
         if(keyboard.justPressed(GLFW_KEY_F12)){
             glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
@@ -333,8 +407,11 @@ int our::Application::run(int run_for_frames) {
             } else break;
         }
 
-        // Swap the frame buffers
-        glfwSwapBuffers(window);
+        // Swap the frame buffers (a headless frame stays in the framebuffer until the next one overwrites it)
+        if(window) {
+            RECORD_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
 
         // Update the keyboard and mouse data
         keyboard.update();
@@ -356,10 +433,16 @@ int our::Application::run(int run_for_frames) {
             currentState = nextState;
             nextState = nullptr;
             // Initialize the new scene
-            currentState->onInitialize();
+            {
+                RECORD_ZONE("State::onInitialize");
+                currentState->onInitialize();
+            }
+            // The new scene may take a few frames to settle (e.g. loading), so these frames are not counted as hitches
+            FlightRecorder::restartWarmup();
 
             
             //Switch music
+            if(result != MA_SUCCESS) continue;
             ma_sound_stop(currentMusic);
             currentMusic = nextMusic;
             nextMusic = nullptr;
@@ -375,16 +458,30 @@ int our::Application::run(int run_for_frames) {
     if(currentState) currentState->onDestroy();
     delete pEngine;
 
+    // Stop the worker threads of the job system (if any were started)
+    JobSystem::shutdown();
+
+    // The queries must be deleted while the context still exists
+    imguiTimer.destroy();
+    GPUProfiler::closeCSV();
+    // If the run ended during the CPU trace, write the frames captured so far (and the same for a pending hitch)
+    CPUProfiler::endCapture();
+    FlightRecorder::shutdown();
+
     // Shutdown ImGui & destroy the context
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if(window) ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    // Destroy the window
-    glfwDestroyWindow(window);
+    if(headless) {
+        headlessContext.destroy();
+    } else {
+        // Destroy the window
+        glfwDestroyWindow(window);
 
-    // And finally terminate GLFW
-    glfwTerminate();
+        // And finally terminate GLFW
+        glfwTerminate();
+    }
     return 0; // Good bye
 }
 
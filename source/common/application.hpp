@@ -13,6 +13,8 @@
 
 #include "input/keyboard.hpp"
 #include "input/mouse.hpp"
+#include "headless-context.hpp"
+#include "gpu-timers.hpp"
 
 namespace our {
 
@@ -54,6 +56,21 @@ namespace our {
     class Application {
     protected:
         GLFWwindow * window = nullptr;      // Pointer to the window created by GLFW using "glfwCreateWindow()".
+
+        // In headless mode, there is no window (so no input either) and the frames are drawn to the framebuffer of
+        // "headlessContext" (see "headless-context.hpp"). The frames are HEADLESS_DELTA_TIME apart no matter how long
+        // they take to draw, so the same run always draws the same frames (which is what image comparisons need).
+        bool headless = false;
+        std::string headlessBackend;
+        HeadlessContext headlessContext;
+        bool closeRequested = false;        // Set by "close" (a headless application has no window to close)
+
+        // The GPU time of drawing the ImGui is measured here since the states don't draw it (see "gpu-profiler.hpp")
+        // The profiler panel is shown if "profiler.overlay" is true in the config and F3 toggles it
+        GPUTimers imguiTimer;
+        bool showProfiler = false;
+        // The engine stats panel (see "stats-panel.hpp") is shown if "profiler.stats" is true in the config and F4 toggles it
+        bool showStats = false;
         
         Keyboard keyboard;                  // Instance of "our" keyboard class that handles keyboard functionalities.
         Mouse mouse;                        // Instance of "our" mouse class that handles mouse functionalities.
@@ -79,9 +96,19 @@ namespace our {
         // On destruction, delete all the states
         ~Application(){ for (auto &it : states) delete it.second;}
 
+        // The time between the frames in headless mode (in seconds)
+        static constexpr double HEADLESS_DELTA_TIME = 1.0 / 60.0;
+
         // This is the main class function that run the whole application (Initialize, Game loop, House cleaning).
         int run(int run_for_frames = 0);
 
+        // Makes "run" create a headless context with the given backend ("egl", "osmesa" or "" for any) instead of a window
+        void setHeadless(const std::string& backend){
+            headless = true;
+            headlessBackend = backend;
+        }
+        [[nodiscard]] bool isHeadless() const { return headless; }
+
         // Register a state for use by the application
         // The state is uniquely identified by its name
         // If the name is already used, the old name owner is deleted and the new state takes its place
@@ -108,10 +135,12 @@ namespace our {
 
         // Closes the Application
         void close(){
-            glfwSetWindowShouldClose(window, GLFW_TRUE);
+            if(window) glfwSetWindowShouldClose(window, GLFW_TRUE);
+            closeRequested = true;
         }
 
         // Class Getters.
+        // The window is null in headless mode
         GLFWwindow* getWindow(){ return window; }
         [[nodiscard]] const GLFWwindow* getWindow() const { return window; }
         Keyboard& getKeyboard() { return keyboard; }
@@ -123,6 +152,7 @@ namespace our {
 
         // Get the size of the frame buffer of the window in pixels.
         glm::ivec2 getFrameBufferSize() {
+            if(headless) return headlessContext.getSize();
             glm::ivec2 size;
             glfwGetFramebufferSize(window, &(size.x), &(size.y));
             return size;
@@ -131,6 +161,7 @@ namespace our {
         // Get the window size. In most cases, it is equal to the frame buffer size.
         // But on some platforms, the framebuffer size may be different from the window size.
         glm::ivec2 getWindowSize() {
+            if(headless) return headlessContext.getSize();
             glm::ivec2 size;
             glfwGetWindowSize(window, &(size.x), &(size.y));
             return size;
@@ -8,6 +8,7 @@
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
+#include "cpu-profiler.hpp"
 
 namespace our {
 
@@ -16,6 +17,7 @@ namespace our {
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
+        PROFILE_SCOPE("AssetLoader<ShaderProgram>::deserialize");
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string vsPath = desc.value("vs", "");
@@ -34,6 +36,7 @@ namespace our {
     //    { texture_name : "path/to/image", ... }
     template<>
     void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
+        PROFILE_SCOPE("AssetLoader<Texture2D>::deserialize");
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
@@ -51,6 +54,7 @@ namespace our {
     //  For "MAX_ANISOTROPY", the value must be a float with a value >= 1.0f
     template<>
     void AssetLoader<Sampler>::deserialize(const nlohmann::json& data) {
+        PROFILE_SCOPE("AssetLoader<Sampler>::deserialize");
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 auto sampler = new Sampler();
@@ -65,6 +69,7 @@ namespace our {
     //    { mesh_name : "path/to/3d-model-file", ... }
     template<>
     void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
+        PROFILE_SCOPE("AssetLoader<Mesh>::deserialize");
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
@@ -87,6 +92,7 @@ namespace our {
     //      ... more keys/values can be added depending on the material type (e.g. "texture", "sampler", "tint")
     template<>
     void AssetLoader<Material>::deserialize(const nlohmann::json& data) {
+        PROFILE_SCOPE("AssetLoader<Material>::deserialize");
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
                 std::string type = desc.value("type", "");
@@ -98,6 +104,7 @@ namespace our {
     };
 
     void deserializeAllAssets(const nlohmann::json& assetData){
+        PROFILE_SCOPE("deserializeAllAssets");
         if(!assetData.is_object()) return;
         if(assetData.contains("shaders"))
             AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
@@ -32,6 +32,8 @@ namespace our {
             }
             return nullptr;
         };
+        // Returns all the loaded assets of this type (by name)
+        static const std::unordered_map<std::string, T*>& getAll() { return assets; }
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
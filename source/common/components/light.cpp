@@ -3,6 +3,8 @@
 #include "./component-deserializer.hpp"     
 #include <glm/gtx/euler_angles.hpp>       
 #include <iostream>                        
+#include <cmath>
+#include <limits>
 
 namespace our
 {    
@@ -39,4 +41,37 @@ namespace our
         }
     }
     
+    float LightComponent::getRange() const
+    {
+        // Directional lights have no position, so they reach everything
+        if (lightType == 0)
+            return std::numeric_limits<float>::infinity();
+        float intensity = glm::max(glm::max(diffuse.r, glm::max(diffuse.g, diffuse.b)),
+                                   glm::max(specular.r, glm::max(specular.g, specular.b)));
+        if (intensity <= 0)
+            return 0;
+        // The shader divides the light by (a*d^2 + b*d + c), so we find the distance "d" where the light drops to CUTOFF
+        // by solving a*d^2 + b*d + c = intensity / CUTOFF
+        float a = attenuation.x, b = attenuation.y, c = attenuation.z;
+        float k = intensity / CUTOFF;
+        if (c >= k)
+            return 0;
+        if (a > 0)
+            return (-b + std::sqrt(b * b - 4 * a * (c - k))) / (2 * a);
+        if (b > 0)
+            return (k - c) / b;
+        // The light never fades out
+        return std::numeric_limits<float>::infinity();
+    }
+
+    float LightComponent::getIntensityAt(float distance) const
+    {
+        float intensity = glm::max(glm::max(diffuse.r, glm::max(diffuse.g, diffuse.b)),
+                                   glm::max(specular.r, glm::max(specular.g, specular.b)));
+        if (lightType == 0)
+            return intensity;
+        float falloff = glm::dot(attenuation, glm::vec3(distance * distance, distance, 1.0f));
+        return falloff > 0 ? intensity / falloff : std::numeric_limits<float>::infinity();
+    }
+
 }
@@ -26,6 +26,13 @@ namespace our {
         glm::vec3 attenuation;      // Attenuation parameters for the light
         glm::vec2 cone_angles;      // Cone angles for spotlights
         std::string lightTypeStr;   // String representation of the light type
+
+        // A point or spot light stops affecting a surface when its attenuated intensity drops below this value
+        static constexpr float CUTOFF = 1.0f / 256.0f;
+        // Returns the distance beyond which the light has no visible effect (or infinity if it never fades out)
+        float getRange() const;
+        // Returns an estimate of the intensity of the light at the given distance (used to pick the most relevant lights)
+        float getIntensityAt(float distance) const;
         // Reads light data from json file
         void deserialize(const nlohmann::json& data) override;
         
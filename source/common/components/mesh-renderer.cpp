@@ -13,5 +13,6 @@ namespace our {
         // Look at "source/common/asset-loader.hpp" to know how to use the static class AssetLoader.
         material = AssetLoader<Material>::get(data["material"].get<std::string>());
         mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());
+        isStatic = data.value("static", false);
     }
 }
\ No newline at end of file
@@ -4,14 +4,41 @@
 #include "../mesh/mesh.hpp"
 #include "../material/material.hpp"
 #include "../asset-loader.hpp"
+#include <vector>
+#include <algorithm>
 
 namespace our {
 
+    // The rules used to pick the level of detail of a mesh from its size on the screen
+    // The size is the diameter of the mesh bounding sphere divided by the viewport height
+    struct LODSettings {
+        // Level "i + 1" is used when the size is below thresholds[i] (so they should be in a decreasing order)
+        std::vector<float> thresholds = {0.25f, 0.12f, 0.06f};
+        // A level only changes once the size moves this fraction past the threshold, so objects around
+        // a threshold don't keep switching back and forth (popping) while the camera moves a tiny bit
+        float hysteresis = 0.15f;
+
+        // Returns the level that should replace "current" for an object of the given size
+        int pick(int current, float screenSize) const {
+            int levelCount = (int)thresholds.size();
+            current = std::clamp(current, 0, levelCount);
+            while(current < levelCount && screenSize < thresholds[current] * (1.0f - hysteresis)) current++;
+            while(current > 0 && screenSize > thresholds[current - 1] * (1.0f + hysteresis)) current--;
+            return current;
+        }
+    };
+
     // This component denotes that any renderer should draw the given mesh using the given material at the transformation of the owning entity.
     class MeshRendererComponent : public Component {
     public:
         Mesh* mesh; // The mesh that should be drawn
         Material* material; // The material used to draw the mesh
+        bool isStatic = false; // If true, the entity promises to never move so the renderer can merge it with other static
+                               // entities sharing the same material (see "ForwardRenderer::buildStaticBatches")
+        int lod = 0; // The level of detail picked in the last frame (the next pick depends on it, see "LODSettings")
+
+        // Picks the level of detail for the given size on the screen
+        void updateLOD(const LODSettings& settings, float screenSize) { lod = settings.pick(lod, screenSize); }
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
@@ -0,0 +1,140 @@
+#include "cpu-profiler.hpp"
+
+#include <json/json.hpp>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace our {
+
+    namespace {
+        struct Event {
+            const char* name;
+            CPUProfiler::Clock::time_point start, end;
+        };
+
+        // The events of one thread. Only its thread writes to it, and "count" is published after the event is written
+        // so the main thread can read the events without locks (the main thread only reads them between frames anyway).
+        struct ThreadBuffer {
+            std::vector<Event> events;
+            std::atomic<size_t> count{0};
+            size_t dropped = 0;
+            unsigned index = 0;
+            std::string name;
+        };
+
+        // The registry owns the buffers so that they outlive their threads (the workers may stop before the capture is written)
+        std::mutex registryMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        thread_local ThreadBuffer* localBuffer = nullptr;
+
+        std::atomic<bool> capturing{false};
+        bool capturePending = false;
+        std::string capturePath;
+        uint64_t captureFirstFrame = 0, captureLastFrame = 0;
+        CPUProfiler::Clock::time_point captureStart;
+
+        ThreadBuffer* getLocalBuffer() {
+            if(!localBuffer) {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                buffers.push_back(std::make_unique<ThreadBuffer>());
+                localBuffer = buffers.back().get();
+                localBuffer->index = (unsigned)buffers.size() - 1;
+                localBuffer->name = "Thread " + std::to_string(localBuffer->index);
+            }
+            return localBuffer;
+        }
+
+        // The trace times are in microseconds since the start of the capture
+        double toMicroseconds(CPUProfiler::Clock::duration duration) {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        }
+
+        void writeCapture() {
+            capturing.store(false);
+            std::ofstream file(capturePath);
+            if(!file) {
+                std::cerr << "Failed to open the trace file: " << capturePath << std::endl;
+                return;
+            }
+            std::lock_guard<std::mutex> lock(registryMutex);
+            // The format is described in "Trace Event Format" (the JSON object format with complete "X" events)
+            file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            bool first = true;
+            size_t total = 0, dropped = 0;
+            for(auto& buffer : buffers) {
+                if(!first) file << ",\n";
+                first = false;
+                file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->index
+                     << ",\"args\":{\"name\":" << nlohmann::json(buffer->name).dump() << "}}";
+                size_t count = buffer->count.load(std::memory_order_acquire);
+                for(size_t index = 0; index < count; index++) {
+                    const Event& event = buffer->events[index];
+                    file << ",\n{\"name\":" << nlohmann::json(event.name).dump()
+                         << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->index
+                         << ",\"ts\":" << toMicroseconds(event.start - captureStart)
+                         << ",\"dur\":" << toMicroseconds(event.end - event.start) << "}";
+                }
+                total += count;
+                dropped += buffer->dropped;
+            }
+            file << "\n]}\n";
+            std::cout << "CPU trace of frames " << captureFirstFrame << " to " << captureLastFrame << " (" << total
+                      << " events) saved to: " << capturePath << std::endl;
+            if(dropped > 0) std::cerr << "The CPU trace is missing " << dropped << " events (the buffers were full)" << std::endl;
+        }
+    }
+
+    void CPUProfiler::requestCapture(const std::string& path, uint64_t firstFrame, uint64_t lastFrame) {
+        if(!ENABLED) std::cerr << "The CPU profiler is disabled in this build, so the trace will be empty" << std::endl;
+        capturePath = path;
+        captureFirstFrame = firstFrame;
+        captureLastFrame = lastFrame;
+        capturePending = true;
+    }
+
+    void CPUProfiler::beginFrame(uint64_t frame) {
+        if(capturing.load(std::memory_order_relaxed)) {
+            if(frame > captureLastFrame) writeCapture();
+        } else if(capturePending && frame >= captureFirstFrame && frame <= captureLastFrame) {
+            capturePending = false;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for(auto& buffer : buffers) {
+                    buffer->count.store(0, std::memory_order_relaxed);
+                    buffer->dropped = 0;
+                }
+            }
+            captureStart = Clock::now();
+            capturing.store(true);
+        }
+    }
+
+    void CPUProfiler::endCapture() {
+        if(capturing.load()) writeCapture();
+    }
+
+    void CPUProfiler::setThreadName(const std::string& name) {
+        ThreadBuffer* buffer = getLocalBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->name = name;
+    }
+
+    void CPUProfiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+        if(!capturing.load(std::memory_order_relaxed)) return;
+        ThreadBuffer* buffer = getLocalBuffer();
+        // The buffer is allocated the first time its thread records during a capture
+        if(buffer->events.empty()) buffer->events.resize(EVENTS_PER_THREAD);
+        size_t count = buffer->count.load(std::memory_order_relaxed);
+        if(count == EVENTS_PER_THREAD) {
+            buffer->dropped++;
+            return;
+        }
+        buffer->events[count] = Event{name, start, end};
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+}
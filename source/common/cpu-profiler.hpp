@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if !defined(NDEBUG) && !defined(ENABLE_CPU_PROFILER)
+// If NDEBUG (no debug) is not defined, enable the CPU profiler
+// In release builds, it can be enabled by defining ENABLE_CPU_PROFILER (see the option "PROFILE" in "CMakeLists.txt")
+#define ENABLE_CPU_PROFILER
+#endif
+
+namespace our {
+
+    // Records the time taken by the instrumented scopes of the CPU code (see "PROFILE_SCOPE") on every thread
+    // while a capture is running, then writes them to a Chrome trace file (JSON) which can be opened in
+    // "chrome://tracing" or "https://ui.perfetto.dev" to see the frames as a timeline.
+    // Every thread writes to its own event buffer so recording a scope needs no locks. The buffers are only
+    // read (and reset) by the main thread between frames, where no jobs are running (see "job-system.hpp").
+    class CPUProfiler {
+    public:
+        // Whether "PROFILE_SCOPE" records anything in this build
+#if defined(ENABLE_CPU_PROFILER)
+        static constexpr bool ENABLED = true;
+#else
+        static constexpr bool ENABLED = false;
+#endif
+        // The maximum number of events kept per thread during a capture (the extra events are dropped)
+        static constexpr size_t EVENTS_PER_THREAD = 1 << 18;
+
+        using Clock = std::chrono::steady_clock;
+
+        // Records the time from its construction to its destruction under the given name.
+        // The name must outlive the capture (e.g. a string literal) since only its pointer is stored.
+        class Scope {
+            const char* name;
+            Clock::time_point start;
+        public:
+            explicit Scope(const char* name) : name(name), start(Clock::now()) {}
+            ~Scope() { CPUProfiler::record(name, start, Clock::now()); }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+
+        // Requests a capture of the frames [firstFrame, lastFrame] (inclusive) to be written to the given path
+        static void requestCapture(const std::string& path, uint64_t firstFrame, uint64_t lastFrame);
+        // Called by the application at the start of every frame. It starts the requested capture at its first frame
+        // and writes it once its last frame ends.
+        static void beginFrame(uint64_t frame);
+        // Writes the capture (if it is running) with the frames recorded so far. This is called when the application closes.
+        static void endCapture();
+
+        // Names the calling thread in the trace (otherwise it is called "Thread <index>")
+        static void setThreadName(const std::string& name);
+
+        // Adds an event to the buffer of the calling thread (if a capture is running)
+        static void record(const char* name, Clock::time_point start, Clock::time_point end);
+    };
+
+}
+
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+
+// Measures the time from this line to the end of the enclosing scope, e.g. PROFILE_SCOPE("ForwardRenderer::render");
+// It compiles to nothing if the profiler is disabled
+#if defined(ENABLE_CPU_PROFILER)
+#define PROFILE_SCOPE(name) our::CPUProfiler::Scope PROFILE_CONCATENATE(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -13,6 +13,7 @@ namespace our {
     // Thus any renderer system should look for an entity holding a camera component in order to compute the camera related uniforms (e.g. VP matrix)
     class Component {
         Entity* owner; // A pointer to the entity that owns this component
+        std::string (*typeID)() = &Component::getID; // The "getID" of the type of this component (set by the entity)
         friend Entity; // The entity is a friend since it is the only one allowed to set itself as an owner of a certain component.
     public:
         // This static method returns a unique string that identifies each type of components
@@ -24,6 +25,8 @@ namespace our {
         virtual void deserialize(const nlohmann::json& data) = 0;
         // Returns the owner of this component
         Entity* getOwner() const { return owner; }
+        // Returns the ID of the type of this component (e.g. "Mesh Renderer"), unlike "getID" which is static
+        std::string getTypeID() const { return typeID(); }
         // Define a virtual destructor
         virtual ~Component(){}
     };
@@ -26,6 +26,7 @@ namespace our {
         World* getWorld() const { return world; } // Returns the world to which this entity belongs
 
         glm::mat4 getLocalToWorldMatrix() const; // Computes and returns the transformation from the entities local space to the world space
+        const std::list<Component*>& getComponents() const { return components; } // Returns all the components of this entity
         void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
         
         // This template method create a component of type T,
@@ -37,6 +38,7 @@ namespace our {
             // Don't forget to return a pointer to the new component
             T* ptr = new T();
             ptr->owner = this;
+            ptr->typeID = &T::getID;
             Component* bp = ptr;
             components.push_back(bp);
             return ptr;
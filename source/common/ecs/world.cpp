@@ -1,4 +1,5 @@
 #include "world.hpp"
+#include "../cpu-profiler.hpp"
 
 namespace our
 {
@@ -8,6 +9,7 @@ namespace our
     // If any of the entities has children, this function will be called recursively for these children
     void World::deserialize(const nlohmann::json &data, Entity *parent)
     {
+        PROFILE_SCOPE("World::deserialize");
         if (!data.is_array())
             return;
         for (const auto &entityData : data)
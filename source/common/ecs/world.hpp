@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_set>
+#include <map>
 #include "entity.hpp"
 
 namespace our {
@@ -37,6 +38,15 @@ namespace our {
             return entities;
         }
 
+        // Returns the number of components of every type (by the type ID, e.g. "Mesh Renderer") in this world
+        std::map<std::string, size_t> countComponents() const {
+            std::map<std::string, size_t> counts;
+            for(auto entity : entities)
+                for(auto component : entity->getComponents())
+                    counts[component->getTypeID()]++;
+            return counts;
+        }
+
         // This marks an entity for removal by adding it to the "markedForRemoval" set.
         // The elements in the "markedForRemoval" set will be removed and deleted when "deleteMarkedEntities" is called.
         void markForRemoval(Entity* entity){
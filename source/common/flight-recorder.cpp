@@ -0,0 +1,176 @@
+#include "flight-recorder.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace our {
+
+    namespace {
+        using Clock = FlightRecorder::Clock;
+
+        struct ZoneRecord {
+            const char* name;
+            float start, end;   // In milliseconds since the start of the frame
+        };
+
+        struct FrameRecord {
+            uint64_t frame = 0;
+            Clock::time_point start;
+            float milliseconds = 0.0f;
+            FrameCounters counters;
+            int zoneCount = 0;
+            int droppedZones = 0;
+            ZoneRecord zones[FlightRecorder::MAX_ZONES];
+        };
+
+        bool enabled = false;
+        float budget = 33.3f;
+        int after = 30, warmup = 10, maxDumps = 4;
+        std::string directory = "hitches";
+
+        // The ring of frames, where "current" is the frame being recorded and "recorded" is the number of valid frames
+        std::vector<FrameRecord> frames;
+        size_t current = 0, recorded = 0;
+        // Only the main thread (the one that configured the recorder) records zones
+        thread_local bool mainThread = false;
+
+        int warmupLeft = 0;
+        int dumps = 0;
+        // If a spike is waiting to be written, "pendingFrames" is the number of frames to record before writing it
+        bool pending = false;
+        int pendingFrames = 0;
+        uint64_t spikeFrame = 0;
+
+        // Sets the time and the counters of the current frame (the counters must not be reset yet)
+        void finishFrame(Clock::time_point end) {
+            FrameRecord& record = frames[current];
+            record.milliseconds = std::chrono::duration<float, std::milli>(end - record.start).count();
+            record.counters = FrameStats::get();
+        }
+
+        double toMicroseconds(Clock::duration duration) {
+            return std::chrono::duration<double, std::micro>(duration).count();
+        }
+
+        // Writes all the frames in the ring (from the oldest) as a Chrome trace
+        void writeDump() {
+            pending = false;
+            dumps++;
+            std::filesystem::path path = std::filesystem::path(directory) / ("hitch-" + std::to_string(spikeFrame) + ".json");
+            std::error_code error;
+            std::filesystem::create_directories(path.parent_path(), error);
+            std::ofstream file(path);
+            if(!file) {
+                std::cerr << "Failed to open the hitch trace file: " << path.string() << std::endl;
+                return;
+            }
+            // The dump is written right after the current frame is finished, so it is the newest frame in the ring
+            size_t count = recorded;
+            size_t oldest = (current + 1 + frames.size() - count) % frames.size();
+            Clock::time_point origin = frames[oldest].start;
+            file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"Main\"}}";
+            for(size_t index = 0; index < count; index++) {
+                const FrameRecord& record = frames[(oldest + index) % frames.size()];
+                double start = toMicroseconds(record.start - origin);
+                file << ",\n{\"name\":\"Frame " << record.frame << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":" << start
+                     << ",\"dur\":" << record.milliseconds * 1000.0 << ",\"args\":{\"overBudget\":"
+                     << (record.milliseconds > budget ? "true" : "false") << ",\"droppedZones\":" << record.droppedZones << "}}";
+                for(int zone = 0; zone < record.zoneCount; zone++) {
+                    const ZoneRecord& zoneRecord = record.zones[zone];
+                    file << ",\n{\"name\":" << nlohmann::json(zoneRecord.name).dump() << ",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+                         << start + zoneRecord.start * 1000.0 << ",\"dur\":" << (zoneRecord.end - zoneRecord.start) * 1000.0 << "}";
+                }
+                // The counters are shown as graphs under the timeline
+                const FrameCounters& counters = record.counters;
+                file << ",\n{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":0,\"tid\":0,\"ts\":" << start << ",\"args\":{"
+                     << "\"drawCalls\":" << counters.drawCalls << ",\"triangles\":" << counters.triangles
+                     << ",\"stateChanges\":" << counters.stateChanges
+                     << ",\"entities\":" << counters.entities << ",\"allocations\":" << counters.allocations << "}}";
+                if(record.frame == spikeFrame)
+                    file << ",\n{\"name\":\"Hitch\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":" << start << "}";
+            }
+            file << "\n]}\n";
+            std::cout << "Frame " << spikeFrame << " went over the budget (" << budget << " ms), its trace is saved to: "
+                      << path.string() << std::endl;
+        }
+    }
+
+    void FlightRecorder::configure(const nlohmann::json& config) {
+        enabled = config.is_object();
+        if(!enabled) return;
+        budget = config.value("budget", budget);
+        int history = std::max(config.value("history", 240), 2);
+        after = std::clamp(config.value("after", after), 0, history - 2);
+        warmup = config.value("warmup", warmup);
+        maxDumps = config.value("maxDumps", maxDumps);
+        directory = config.value("directory", directory);
+        // All the frames are allocated here so that recording never allocates
+        frames.assign(history, FrameRecord());
+        current = recorded = 0;
+        warmupLeft = warmup;
+        mainThread = true;
+    }
+
+    bool FlightRecorder::isEnabled() {
+        return enabled;
+    }
+
+    void FlightRecorder::beginFrame(uint64_t frame) {
+        if(!enabled) return;
+        Clock::time_point now = Clock::now();
+        if(recorded > 0) {
+            finishFrame(now);
+            const FrameRecord& record = frames[current];
+            if(warmupLeft > 0) {
+                warmupLeft--;
+            } else if(record.milliseconds > budget && !pending && dumps < maxDumps) {
+                // The following frames are recorded too, since a hitch often shows its cause (or its effects) later
+                pending = true;
+                pendingFrames = after;
+                spikeFrame = record.frame;
+            } else if(pending && pendingFrames-- == 0) {
+                writeDump();
+            }
+            current = (current + 1) % frames.size();
+        }
+        // Start the next frame (the time of writing a dump is counted in it so it can be told apart from the hitch)
+        FrameRecord& record = frames[current];
+        record.frame = frame;
+        record.start = now;
+        record.zoneCount = record.droppedZones = 0;
+        recorded = std::min(recorded + 1, frames.size());
+    }
+
+    void FlightRecorder::restartWarmup() {
+        warmupLeft = warmup;
+    }
+
+    void FlightRecorder::shutdown() {
+        if(!enabled) return;
+        if(pending) {
+            // The last frame ended with the game loop
+            finishFrame(Clock::now());
+            writeDump();
+        }
+        enabled = false;
+    }
+
+    void FlightRecorder::record(const char* name, Clock::time_point start, Clock::time_point end) {
+        if(!enabled || !mainThread) return;
+        FrameRecord& record = frames[current];
+        if(record.zoneCount == MAX_ZONES) {
+            record.droppedZones++;
+            return;
+        }
+        record.zones[record.zoneCount++] = ZoneRecord{
+            name,
+            std::chrono::duration<float, std::milli>(start - record.start).count(),
+            std::chrono::duration<float, std::milli>(end - record.start).count()
+        };
+    }
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cpu-profiler.hpp"
+#include "frame-stats.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <json/json.hpp>
+
+namespace our {
+
+    // Always keeps the timings of the last frames (the zones marked by "RECORD_ZONE" and the frame counters of
+    // "frame-stats.hpp") in a ring. When a frame takes longer than the budget, it waits for a few more frames then
+    // writes the frames around the spike to a Chrome trace file (see "cpu-profiler.hpp"), so the hitches that
+    // can't be reproduced under a profiler still leave a trace behind.
+    // The zones are only recorded on the main thread. Recording a zone reads the clock twice and writes to
+    // a preallocated frame, so it can stay on in release builds.
+    class FlightRecorder {
+    public:
+        // The maximum number of zones recorded per frame (the extra zones are dropped)
+        static constexpr int MAX_ZONES = 32;
+
+        using Clock = std::chrono::steady_clock;
+
+        // Records the time from its construction to its destruction as a zone of the current frame
+        // The name must be a string literal since only its pointer is kept
+        class Zone {
+            const char* name;
+            Clock::time_point start;
+        public:
+            explicit Zone(const char* name) : name(name), start(Clock::now()) {}
+            ~Zone() { FlightRecorder::record(name, start, Clock::now()); }
+            Zone(const Zone&) = delete;
+            Zone& operator=(const Zone&) = delete;
+        };
+
+        // Reads the settings from the "flightRecorder" object of the app config and starts recording:
+        // "budget" (the frame time in milliseconds that counts as a spike), "history" (the frames kept in the ring),
+        // "after" (the frames recorded after a spike before it is written), "warmup" (the frames ignored after
+        // a state change, which are expected to be slow while loading), "maxDumps" and "directory"
+        // The recorder stays off if the config is not an object
+        static void configure(const nlohmann::json& config);
+        static bool isEnabled();
+
+        // Called by the application at the start of every frame (on the main thread) before the frame stats are reset.
+        // It finishes the previous frame (its time and counters), checks it against the budget and writes
+        // the pending trace if enough frames have passed since the spike.
+        static void beginFrame(uint64_t frame);
+        // Starts the warmup again (called when the state changes)
+        static void restartWarmup();
+        // Writes the pending trace (if any) with the frames recorded so far. This is called when the application closes.
+        static void shutdown();
+
+        // Adds a zone to the current frame (ignored on the other threads)
+        static void record(const char* name, Clock::time_point start, Clock::time_point end);
+    };
+
+}
+
+// Records the time from this line to the end of the enclosing scope in the flight recorder (and in the CPU profiler)
+// It is meant for the few coarse parts of a frame since it is never compiled out
+#define RECORD_ZONE(name) PROFILE_SCOPE(name); our::FlightRecorder::Zone PROFILE_CONCATENATE(recordedZone, __LINE__)(name)
@@ -0,0 +1,74 @@
+#include "frame-stats.hpp"
+#include "gl-state-cache.hpp"
+#include "ecs/world.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace our {
+
+    void FrameStats::beginFrame() {
+        counters = FrameCounters();
+        stateChangesAtStart = GLStateCache::getCounters().issued;
+        allocationsAtStart = allocationCount.load(std::memory_order_relaxed);
+    }
+
+    void FrameStats::setWorld(World* drawnWorld) {
+        world = drawnWorld;
+        counters.entities = world->getEntities().size();
+    }
+
+    FrameCounters FrameStats::get() {
+        FrameCounters result = counters;
+        result.stateChanges = GLStateCache::getCounters().issued - stateChangesAtStart;
+        result.allocations = allocationCount.load(std::memory_order_relaxed) - allocationsAtStart;
+        return result;
+    }
+
+}
+
+// The replaced allocation functions only count the call then allocate like the default ones.
+// The sized deletes are replaced too (the default ones would call the ones below anyway, but sanitizers replace
+// them with their own), and the aligned versions (over-aligned types) are not counted.
+void* operator new(std::size_t size) {
+    our::FrameStats::countAllocation();
+    if(size == 0) size = 1;
+    while(true) {
+        if(void* pointer = std::malloc(size)) return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if(!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch(...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
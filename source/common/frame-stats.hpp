@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace our {
+
+    class World; // Forward declaration
+
+    // The amount of work done in a frame
+    struct FrameCounters {
+        std::uint64_t drawCalls = 0;
+        std::uint64_t triangles = 0;
+        std::uint64_t stateChanges = 0;     // The state changes that were sent to OpenGL (see "gl-state-cache.hpp")
+        std::uint64_t programBinds = 0;     // The binds that were sent to OpenGL (the redundant ones are filtered by the state cache)
+        std::uint64_t textureBinds = 0;
+        std::uint64_t vertexArrayBinds = 0;
+        std::uint64_t materialSetups = 0;
+        std::uint64_t visibleCommands = 0;  // The render commands that passed the culling (see "forward-renderer.hpp")
+        std::uint64_t culledCommands = 0;   // The render commands hidden by the potentially visible set or the occlusion culling
+        std::uint64_t entities = 0;         // The entities in the world drawn in the frame
+        std::uint64_t allocations = 0;      // The calls to "operator new" on all the threads
+    };
+
+    // Counts the work done in the current frame. The application starts a new frame by calling "beginFrame".
+    // The counting is always on, so every counter is just an increment (the allocations are counted by replacing
+    // the global "operator new" in "frame-stats.cpp", with an atomic since every thread can allocate).
+    class FrameStats {
+        static inline FrameCounters counters;
+        static inline std::atomic<std::uint64_t> allocationCount{0};
+        // The totals at the start of the frame (the state cache and the allocations are counted since the start)
+        static inline std::uint64_t stateChangesAtStart = 0, allocationsAtStart = 0;
+        // The last world drawn by the renderer (it is kept between frames so the stats panel can look into it)
+        static inline World* world = nullptr;
+
+    public:
+        // Resets the counters for a new frame
+        static void beginFrame();
+        // Returns the counters of the current frame so far
+        static FrameCounters get();
+
+        static void countDraw(std::uint64_t triangles) {
+            ++counters.drawCalls;
+            counters.triangles += triangles;
+        }
+        static void countProgramBind() { ++counters.programBinds; }
+        static void countTextureBind() { ++counters.textureBinds; }
+        static void countVertexArrayBind() { ++counters.vertexArrayBinds; }
+        static void countMaterialSetup() { ++counters.materialSetups; }
+        static void countCommands(std::uint64_t visible, std::uint64_t culled) {
+            counters.visibleCommands += visible;
+            counters.culledCommands += culled;
+        }
+        static void countAllocation() { allocationCount.fetch_add(1, std::memory_order_relaxed); }
+
+        // Called by the renderer with the world it draws
+        static void setWorld(World* drawnWorld);
+        static World* getWorld() { return world; }
+    };
+
+}
@@ -0,0 +1,38 @@
+#include "gl-state-cache.hpp"
+
+namespace our {
+
+    void GLStateCache::invalidate() {
+        for(auto& capability : capabilities) capability = -1;
+        depthFunction = culledFace = frontFaceWinding = UNKNOWN;
+        depthWrite = colorWrite = -1;
+        blendEq = blendSource = blendDestination = UNKNOWN;
+        blendConstantKnown = false;
+        program = vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for(GLuint unit = 0; unit < MAX_TEXTURE_UNITS; ++unit) {
+            textures[unit] = UNKNOWN;
+            samplers[unit] = UNKNOWN;
+        }
+    }
+
+    // When a bound object is deleted, OpenGL either reverts the binding to 0 or (for programs) keeps it in use
+    // till another one is used. Either way, marking the binding as unknown is always correct.
+
+    void GLStateCache::forgetProgram(GLuint name) {
+        if(program == name) program = UNKNOWN;
+    }
+
+    void GLStateCache::forgetVertexArray(GLuint name) {
+        if(vertexArray == name) vertexArray = UNKNOWN;
+    }
+
+    void GLStateCache::forgetTexture(GLuint name) {
+        for(auto& texture : textures) if(texture == name) texture = UNKNOWN;
+    }
+
+    void GLStateCache::forgetSampler(GLuint name) {
+        for(auto& sampler : samplers) if(sampler == name) sampler = UNKNOWN;
+    }
+
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec4.hpp>
+#include "frame-stats.hpp"
+#include <cstdint>
+
+namespace our {
+
+    // "issued" counts the state changes that were sent to OpenGL
+    // "filtered" counts the state changes that were dropped since they would not have changed anything
+    struct GLStateCounters {
+        std::uint64_t issued = 0;
+        std::uint64_t filtered = 0;
+    };
+
+    // OpenGL is a state machine and every state call goes through the driver even if it sets a value
+    // that is already current. Since every material re-applies its whole pipeline state, texture bindings
+    // and shader before each draw, most of these calls are redundant.
+    // This static class keeps a shadow copy of the context state that the engine touches while rendering
+    // (capabilities, depth/cull/blend options, masks and object bindings) and only forwards a call to OpenGL
+    // when the requested value differs from the shadowed one.
+    // WARNING: All engine code that changes these states should go through this class, otherwise the shadow copy
+    // will go out of sync. If some code has to call OpenGL directly (e.g. ImGui), call "invalidate" afterwards.
+    class GLStateCache {
+    public:
+        using Counters = GLStateCounters;
+
+        // The number of texture units whose bindings we track (the GL 3.3 minimum is 16 per stage)
+        static constexpr GLuint MAX_TEXTURE_UNITS = 16;
+
+    private:
+        // A value that no valid GL enum or object name can have, so the first call after "invalidate" is always issued
+        static constexpr GLuint UNKNOWN = ~0u;
+        // The capabilities we track, every other capability is passed directly to OpenGL
+        enum Capability { DEPTH_TEST, CULL_FACE, BLEND, SCISSOR_TEST, STENCIL_TEST, CAPABILITY_COUNT };
+
+        static inline GLint capabilities[CAPABILITY_COUNT];      // 1 = enabled, 0 = disabled, -1 = unknown
+        static inline GLenum depthFunction, culledFace, frontFaceWinding;
+        static inline GLint depthWrite;                          // 1 = true, 0 = false, -1 = unknown
+        static inline GLint colorWrite;                          // 4 bits (RGBA), -1 = unknown
+        static inline GLenum blendEq, blendSource, blendDestination;
+        static inline glm::vec4 blendConstant;
+        static inline bool blendConstantKnown;
+        static inline GLuint program, vertexArray;
+        static inline GLuint activeUnit;
+        static inline GLuint textures[MAX_TEXTURE_UNITS];
+        static inline GLuint samplers[MAX_TEXTURE_UNITS];
+
+        static inline Counters counters;
+
+        // Returns true (and updates the shadow value) if the call should be sent to OpenGL
+        template<typename T>
+        static bool changed(T& shadow, T value) {
+            if(shadow == value) {
+                ++counters.filtered;
+                return false;
+            }
+            shadow = value;
+            ++counters.issued;
+            return true;
+        }
+
+        static int capabilityIndex(GLenum capability) {
+            switch(capability) {
+                case GL_DEPTH_TEST: return DEPTH_TEST;
+                case GL_CULL_FACE: return CULL_FACE;
+                case GL_BLEND: return BLEND;
+                case GL_SCISSOR_TEST: return SCISSOR_TEST;
+                case GL_STENCIL_TEST: return STENCIL_TEST;
+                default: return -1;
+            }
+        }
+
+    public:
+        // Forget everything we know about the context, so the next call to each state is always sent to OpenGL
+        // This must be called once the context is created and whenever the state is changed outside this class
+        static void invalidate();
+
+        // Call these after deleting an OpenGL object, since OpenGL may give the same name to a new object
+        static void forgetProgram(GLuint name);
+        static void forgetVertexArray(GLuint name);
+        static void forgetTexture(GLuint name);
+        static void forgetSampler(GLuint name);
+
+        // Returns the number of issued and filtered calls since the last call to "resetCounters"
+        static const Counters& getCounters() { return counters; }
+        static void resetCounters() { counters = Counters(); }
+
+        // Equivalent to glEnable/glDisable
+        static void setCapability(GLenum capability, bool enabled) {
+            int index = capabilityIndex(capability);
+            if(index < 0) {
+                // Untracked capability, so we can't tell if it is redundant
+                if(enabled) glEnable(capability); else glDisable(capability);
+                ++counters.issued;
+                return;
+            }
+            if(changed(capabilities[index], (GLint)enabled)) {
+                if(enabled) glEnable(capability); else glDisable(capability);
+            }
+        }
+
+        static void depthFunc(GLenum function) {
+            if(changed(depthFunction, function)) glDepthFunc(function);
+        }
+
+        static void depthMask(bool enabled) {
+            if(changed(depthWrite, (GLint)enabled)) glDepthMask(enabled);
+        }
+
+        static void colorMask(glm::bvec4 mask) {
+            GLint bits = (mask.r ? 1 : 0) | (mask.g ? 2 : 0) | (mask.b ? 4 : 0) | (mask.a ? 8 : 0);
+            if(changed(colorWrite, bits)) glColorMask(mask.r, mask.g, mask.b, mask.a);
+        }
+
+        static void cullFace(GLenum face) {
+            if(changed(culledFace, face)) glCullFace(face);
+        }
+
+        static void frontFace(GLenum winding) {
+            if(changed(frontFaceWinding, winding)) glFrontFace(winding);
+        }
+
+        // The same equation is used for both the color and the alpha (same as glBlendEquation)
+        static void blendEquation(GLenum equation) {
+            if(changed(blendEq, equation)) glBlendEquation(equation);
+        }
+
+        static void blendFunc(GLenum sourceFactor, GLenum destinationFactor) {
+            // Both factors are sent in one call, so we count them as one state
+            if(blendSource == sourceFactor && blendDestination == destinationFactor) {
+                ++counters.filtered;
+                return;
+            }
+            blendSource = sourceFactor;
+            blendDestination = destinationFactor;
+            ++counters.issued;
+            glBlendFunc(sourceFactor, destinationFactor);
+        }
+
+        static void blendColor(glm::vec4 color) {
+            if(blendConstantKnown && blendConstant == color) {
+                ++counters.filtered;
+                return;
+            }
+            blendConstant = color;
+            blendConstantKnown = true;
+            ++counters.issued;
+            glBlendColor(color.r, color.g, color.b, color.a);
+        }
+
+        static void useProgram(GLuint name) {
+            if(changed(program, name)) {
+                glUseProgram(name);
+                FrameStats::countProgramBind();
+            }
+        }
+
+        static void bindVertexArray(GLuint name) {
+            if(changed(vertexArray, name)) {
+                glBindVertexArray(name);
+                FrameStats::countVertexArrayBind();
+            }
+        }
+
+        // Takes the unit index (0, 1, 2, ...) not the enum (GL_TEXTURE0, ...)
+        static void activeTexture(GLuint unit) {
+            if(changed(activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        // Binds the texture to GL_TEXTURE_2D of the active texture unit
+        static void bindTexture2D(GLuint name) {
+            if(activeUnit >= MAX_TEXTURE_UNITS) {
+                // The active unit is unknown or untracked, so we can't tell if it is redundant
+                glBindTexture(GL_TEXTURE_2D, name);
+                ++counters.issued;
+                FrameStats::countTextureBind();
+                return;
+            }
+            if(changed(textures[activeUnit], name)) {
+                glBindTexture(GL_TEXTURE_2D, name);
+                FrameStats::countTextureBind();
+            }
+        }
+
+        static void bindSampler(GLuint unit, GLuint name) {
+            if(unit >= MAX_TEXTURE_UNITS) {
+                glBindSampler(unit, name);
+                ++counters.issued;
+                return;
+            }
+            if(changed(samplers[unit], name)) glBindSampler(unit, name);
+        }
+    };
+
+}
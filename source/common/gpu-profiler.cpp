@@ -0,0 +1,129 @@
+#include "gpu-profiler.hpp"
+
+#include <imgui.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace our {
+
+    namespace {
+        // The results of a timer in a ring (the oldest result is overwritten once it is full)
+        struct TimerHistory {
+            std::string name;
+            std::vector<float> results;
+            int next = 0;
+            float last = 0.0f;
+            bool skipped = false; // True if the timer wasn't measured in the last frame read
+        };
+        std::vector<TimerHistory> timers;   // In the order they were first recorded (which is the order of the passes)
+        std::vector<float> sorted;          // A copy of the results used to find the percentile
+        std::ofstream csv;
+        unsigned long long frame = 0;
+
+        TimerHistory* find(const std::string& name) {
+            for(auto& timer : timers)
+                if(timer.name == name) return &timer;
+            return nullptr;
+        }
+
+        double average(const TimerHistory& timer) {
+            if(timer.results.empty()) return 0.0;
+            double sum = 0.0;
+            for(float result : timer.results) sum += result;
+            return sum / timer.results.size();
+        }
+
+        double percentile95(const TimerHistory& timer) {
+            if(timer.results.empty()) return 0.0;
+            sorted = timer.results;
+            size_t index = (size_t)std::ceil(0.95 * sorted.size()) - 1;
+            std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+            return sorted[index];
+        }
+    }
+
+    void GPUProfiler::record(const std::string& name, double milliseconds) {
+        TimerHistory* timer = find(name);
+        if(!timer) {
+            timers.push_back(TimerHistory{name, {}, 0, 0.0f, false});
+            timer = &timers.back();
+            timer->results.reserve(HISTORY_SIZE);
+        }
+        timer->last = (float)milliseconds;
+        timer->skipped = false;
+        if((int)timer->results.size() < HISTORY_SIZE) {
+            timer->results.push_back(timer->last);
+        } else {
+            timer->results[timer->next] = timer->last;
+            timer->next = (timer->next + 1) % HISTORY_SIZE;
+        }
+        if(csv.is_open()) csv << frame << ',' << name << ',' << milliseconds << '\n';
+    }
+
+    void GPUProfiler::skip(const std::string& name) {
+        // A timer that was never recorded has no row to clear
+        if(TimerHistory* timer = find(name)) {
+            timer->last = 0.0f;
+            timer->skipped = true;
+        }
+    }
+
+    void GPUProfiler::nextFrame() {
+        frame++;
+    }
+
+    bool GPUProfiler::openCSV(const std::string& path) {
+        closeCSV();
+        csv.open(path);
+        if(!csv) {
+            std::cerr << "Failed to open the GPU profile file: " << path << std::endl;
+            return false;
+        }
+        csv << "frame,pass,milliseconds\n";
+        return true;
+    }
+
+    void GPUProfiler::closeCSV() {
+        if(csv.is_open()) csv.close();
+    }
+
+    double GPUProfiler::getAverage(const std::string& name) {
+        const TimerHistory* timer = find(name);
+        return timer ? average(*timer) : 0.0;
+    }
+
+    double GPUProfiler::getPercentile95(const std::string& name) {
+        const TimerHistory* timer = find(name);
+        return timer ? percentile95(*timer) : 0.0;
+    }
+
+    void GPUProfiler::drawPanel(bool* open) {
+        ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+        if(!ImGui::Begin("GPU Profiler", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+            ImGui::End();
+            return;
+        }
+        // The default font is monospaced, so the table is aligned using the widths of the fields
+        ImGui::Text("Last %d results (ms)", HISTORY_SIZE);
+        ImGui::Separator();
+        ImGui::Text("%-16s %8s %8s %8s", "Pass", "Last", "Average", "95%");
+        double totalAverage = 0.0, totalLast = 0.0;
+        for(const auto& timer : timers) {
+            double timerAverage = average(timer);
+            totalAverage += timerAverage;
+            totalLast += timer.last;
+            // A pass that didn't run in the last frame shows no last time instead of the time of the last frame it ran in
+            if(timer.skipped)
+                ImGui::Text("%-16s %8s %8.3f %8.3f", timer.name.c_str(), "-", timerAverage, percentile95(timer));
+            else
+                ImGui::Text("%-16s %8.3f %8.3f %8.3f", timer.name.c_str(), timer.last, timerAverage, percentile95(timer));
+        }
+        ImGui::Separator();
+        ImGui::Text("%-16s %8.3f %8.3f", "Total", totalLast, totalAverage);
+        ImGui::End();
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+namespace our {
+
+    // Collects the GPU times measured by all the GPU timers (see "gpu-timers.hpp") and keeps the last HISTORY_SIZE
+    // results of every timer (by name), so it can show their rolling average and 95th percentile in an ImGui panel.
+    // The results can also be written to a CSV file (one "frame,pass,milliseconds" row per result) to be studied later.
+    // The application draws the panel after the state GUI and measures the ImGui pass itself.
+    // The frame of a result is the frame in which it was read, which is a few frames after the frame it measures.
+    class GPUProfiler {
+    public:
+        // The number of results kept for every timer
+        static constexpr int HISTORY_SIZE = 240;
+
+        // Adds a result of the given timer (called by the GPU timers whenever they read one)
+        static void record(const std::string& name, double milliseconds);
+        // Marks the given timer as not measured in the frame being read (e.g. its pass was turned off or culled),
+        // so the panel doesn't keep showing its old time as the last one (the history is left as it is)
+        static void skip(const std::string& name);
+        // Moves to the next frame (called once per frame by the application)
+        static void nextFrame();
+
+        // Starts writing every result to the given CSV file (returns false if it couldn't be opened)
+        static bool openCSV(const std::string& path);
+        // Flushes and closes the CSV file (if any)
+        static void closeCSV();
+
+        // Returns the rolling average and the 95th percentile of the given timer in milliseconds (0 if it has no results)
+        static double getAverage(const std::string& name);
+        static double getPercentile95(const std::string& name);
+
+        // Draws the table of the timers in an ImGui window (this must be called between ImGui::NewFrame and ImGui::Render)
+        // "open" is set to false if the user closes the window
+        static void drawPanel(bool* open = nullptr);
+    };
+
+}
@@ -0,0 +1,73 @@
+#include "gpu-timers.hpp"
+#include "gpu-profiler.hpp"
+
+namespace our {
+
+    void GPUTimers::initialize(const std::vector<std::string>& timerNames) {
+        destroy();
+        names = timerNames;
+        queries.resize(names.size() * FRAMES_IN_FLIGHT);
+        glGenQueries((GLsizei)queries.size(), queries.data());
+        issued.assign(queries.size(), false);
+        milliseconds.assign(names.size(), 0.0);
+        frame = 0;
+        active = -1;
+    }
+
+    void GPUTimers::destroy() {
+        if(!queries.empty()) glDeleteQueries((GLsizei)queries.size(), queries.data());
+        queries.clear();
+        issued.clear();
+        milliseconds.clear();
+        names.clear();
+    }
+
+    void GPUTimers::beginFrame() {
+        if(queries.empty()) return;
+        // Move to the oldest frame, its queries were sent FRAMES_IN_FLIGHT - 1 frames ago so they are most likely done
+        // If the GPU is further behind than that, reading a result would wait for it, so the result is left for later
+        frame = (frame + 1) % FRAMES_IN_FLIGHT;
+        size_t first = frame * names.size();
+        for(size_t timer = 0; timer < names.size(); ++timer) {
+            // A pass that was skipped in that frame (e.g. the postprocessing was off) took no time
+            if(!issued[first + timer]) {
+                milliseconds[timer] = 0.0;
+                GPUProfiler::skip(names[timer]);
+                continue;
+            }
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(queries[first + timer], GL_QUERY_RESULT_AVAILABLE, &available);
+            // The query stays issued so it isn't reused this frame, and the timer keeps its last time
+            if(!available) continue;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[first + timer], GL_QUERY_RESULT, &nanoseconds);
+            milliseconds[timer] = nanoseconds / 1e6;
+            issued[first + timer] = false;
+            GPUProfiler::record(names[timer], milliseconds[timer]);
+        }
+    }
+
+    double GPUTimers::getTotalMilliseconds() const {
+        double total = 0.0;
+        for(double time : milliseconds) total += time;
+        return total;
+    }
+
+    void GPUTimers::begin(int timer) {
+        if(queries.empty()) return;
+        if(active >= 0) end();
+        size_t index = frame * names.size() + timer;
+        // The result of the last use of this query isn't ready yet, so the timer isn't measured in this frame
+        if(issued[index]) return;
+        glBeginQuery(GL_TIME_ELAPSED, queries[index]);
+        issued[index] = true;
+        active = timer;
+    }
+
+    void GPUTimers::end() {
+        if(active < 0) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        active = -1;
+    }
+
+}
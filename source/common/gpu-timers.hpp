@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // A set of named GPU timers that measure how long the GPU spends on parts of a frame (e.g. the render passes)
+    // Each timer is a GL_TIME_ELAPSED query around the commands of its part. The GPU finishes a frame a while after
+    // the CPU sends it, so reading the result right away would stall until then. Instead, every timer has a query for
+    // each of the last FRAMES_IN_FLIGHT frames and a result is only read when its query is about to be reused.
+    // If the result still isn't available then (the GPU is more than FRAMES_IN_FLIGHT frames behind), the timer keeps
+    // its last time and skips measuring the frame instead of waiting. This means the times are a few frames old
+    // and some frames are missing when the GPU is overloaded, which is fine for profiling.
+    // Every result is also given to the GPU profiler (see "gpu-profiler.hpp") which keeps their history.
+    // WARNING: The timers can't be nested or overlap (OpenGL allows only one active GL_TIME_ELAPSED query).
+    class GPUTimers {
+    public:
+        static constexpr int FRAMES_IN_FLIGHT = 3;
+
+    private:
+        std::vector<std::string> names;
+        std::vector<GLuint> queries;        // FRAMES_IN_FLIGHT queries for every timer (frame-major)
+        std::vector<bool> issued;           // Whether the query was used (and its result wasn't read yet)
+        std::vector<double> milliseconds;   // The last result of every timer
+        int frame = 0;
+        int active = -1;
+
+    public:
+        // Creates the queries of the given timers (the index of a name is the index of its timer)
+        void initialize(const std::vector<std::string>& timerNames);
+        // Deletes the queries
+        void destroy();
+
+        // Reads the results of the frame whose queries are about to be reused then starts a new frame
+        // This should be called once per frame before any "begin"
+        void beginFrame();
+        // Starts and stops measuring the given timer. A timer that isn't started in a frame measures 0 for that frame.
+        void begin(int timer);
+        void end();
+
+        int getCount() const { return (int)names.size(); }
+        const std::string& getName(int timer) const { return names[timer]; }
+        // Returns the last measured time of the given timer in milliseconds
+        double getMilliseconds(int timer) const { return milliseconds[timer]; }
+        // Returns the sum of the last measured times of all the timers in milliseconds
+        double getTotalMilliseconds() const;
+    };
+
+}
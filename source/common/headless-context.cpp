@@ -0,0 +1,138 @@
+#include "headless-context.hpp"
+
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+bool our::HeadlessContext::create(const std::string& requestedBackend, glm::ivec2 framebufferSize) {
+    destroy();
+    bool created = false;
+    if(requestedBackend.empty() || requestedBackend == "egl") {
+        created = createEGL();
+        if(created) backend = "egl";
+    }
+    if(!created && (requestedBackend.empty() || requestedBackend == "osmesa")) {
+        created = createOSMesa();
+        if(created) backend = "osmesa";
+    }
+    if(!created) {
+        std::cerr << "Failed to create a headless OpenGL context (backend: "
+                  << (requestedBackend.empty() ? "any" : requestedBackend) << ")" << std::endl;
+        return false;
+    }
+
+    // The framebuffer takes the place of the window
+    size = framebufferSize;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "The headless framebuffer is incomplete" << std::endl;
+        destroy();
+        return false;
+    }
+    glViewport(0, 0, size.x, size.y);
+    return true;
+}
+
+bool our::HeadlessContext::createEGL() {
+#if defined(HEADLESS_EGL)
+    // The surfaceless platform needs no display server. If it is missing, the default display may still work.
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay) eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if(eglDisplay == EGL_NO_DISPLAY) eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, nullptr, nullptr)) return false;
+    if(!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(eglDisplay);
+        return false;
+    }
+    // No config and no surface since we only draw to our own framebuffer (EGL_KHR_no_config_context & EGL_KHR_surfaceless_context)
+    EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, (EGLConfig)0, EGL_NO_CONTEXT, attributes);
+    if(eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        if(eglContext != EGL_NO_CONTEXT) eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        return false;
+    }
+    if(!gladLoadGL((GLADloadfunc)eglGetProcAddress)) {
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(eglDisplay, eglContext);
+        eglTerminate(eglDisplay);
+        return false;
+    }
+    display = eglDisplay;
+    context = eglContext;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool our::HeadlessContext::createOSMesa() {
+    if(!glfwInit()) return false;
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    // The window is never shown, so it is kept tiny (the frames go to our framebuffer)
+    window = glfwCreateWindow(1, 1, "", nullptr, nullptr);
+    if(!window) {
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    if(!gladLoadGL(glfwGetProcAddress)) {
+        glfwDestroyWindow(window);
+        window = nullptr;
+        glfwTerminate();
+        return false;
+    }
+    return true;
+}
+
+void our::HeadlessContext::destroy() {
+    if(framebuffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = colorBuffer = depthBuffer = 0;
+    }
+#if defined(HEADLESS_EGL)
+    if(context) {
+        eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+        eglTerminate((EGLDisplay)display);
+    }
+#endif
+    display = context = nullptr;
+    if(window) {
+        glfwDestroyWindow(window);
+        window = nullptr;
+        glfwTerminate();
+    }
+    backend.clear();
+}
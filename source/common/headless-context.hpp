@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <string>
+
+struct GLFWwindow;
+
+namespace our {
+
+    // An OpenGL 3.3 core context without a window, so the application can run on machines without a display or a GPU
+    // (e.g. build and test servers) using a software rasterizer like Mesa's llvmpipe.
+    // There are two backends:
+    //  - "egl": An EGL context on the surfaceless platform of Mesa (only if the build found EGL, see "HEADLESS_EGL").
+    //  - "osmesa": A hidden GLFW window whose context is created by OSMesa (GLFW loads the library when it is needed).
+    //    This needs a GLFW built for OSMesa (GLFW_USE_OSMESA) unless there is a display.
+    // An empty backend name tries them in this order.
+    // Since there is no window, the frames are drawn to a framebuffer of the requested size (with a color and a
+    // depth-stencil renderbuffer) that stays bound in place of the default framebuffer, so screenshots read it too.
+    class HeadlessContext {
+        std::string backend;
+        void *display = nullptr, *context = nullptr;    // The EGL display and context (if the EGL backend is used)
+        GLFWwindow *window = nullptr;                   // The hidden window (if the OSMesa backend is used)
+        GLuint framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+        glm::ivec2 size = glm::ivec2(0);
+
+        bool createEGL();
+        bool createOSMesa();
+
+    public:
+        // Creates the context with the given backend ("egl", "osmesa" or "" for any), loads OpenGL and binds a
+        // framebuffer of the given size. Returns false (after printing why) if no backend could create a context.
+        bool create(const std::string& requestedBackend, glm::ivec2 framebufferSize);
+        // Deletes the framebuffer and the context
+        void destroy();
+
+        // Returns the name of the backend that created the context
+        const std::string& getBackend() const { return backend; }
+        GLuint getFramebuffer() const { return framebuffer; }
+        glm::ivec2 getSize() const { return size; }
+    };
+
+}
@@ -82,9 +82,9 @@ namespace our {
         }
 
         // Locks the mouse position and hides it (Usually used for FPS games)
-        static void lockMouse(GLFWwindow *window) { glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); }
+        static void lockMouse(GLFWwindow *window) { if(window) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); }
         // If the mouse was locked, unlock it (make it visible and allow it to move)
-        static void unlockMouse(GLFWwindow *window) { glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL); }
+        static void unlockMouse(GLFWwindow *window) { if(window) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL); }
 
 
         [[nodiscard]] bool isEnabled() const { return enabled; }
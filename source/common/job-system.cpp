@@ -0,0 +1,122 @@
+#include "job-system.hpp"
+#include "cpu-profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    namespace {
+        std::vector<std::thread> workers;
+        bool initialized = false;
+
+        std::mutex mutex;
+        std::condition_variable wakeCondition;   // Wakes the workers when a new batch is posted (or when stopping)
+        std::condition_variable doneCondition;   // Wakes the main thread when the last worker finishes the batch
+        bool stopping = false;
+        unsigned long long batchGeneration = 0;  // Incremented for every batch so the workers can tell a new batch apart
+        unsigned busyWorkers = 0;                // The number of workers that didn't finish the current batch yet
+
+        // The current batch
+        const JobSystem::Job* batchJob = nullptr;
+        size_t batchCount = 0, batchChunkSize = 0, batchChunkCount = 0;
+        std::atomic<size_t> nextChunk{0};
+
+        // Takes chunks from the current batch till none is left
+        void runChunks(unsigned threadIndex) {
+            for(size_t chunk = nextChunk.fetch_add(1); chunk < batchChunkCount; chunk = nextChunk.fetch_add(1)) {
+                size_t begin = chunk * batchChunkSize;
+                size_t end = std::min(batchCount, begin + batchChunkSize);
+                PROFILE_SCOPE("JobSystem::chunk");
+                (*batchJob)(begin, end, threadIndex);
+            }
+        }
+
+        void workerLoop(unsigned threadIndex) {
+            CPUProfiler::setThreadName("Worker " + std::to_string(threadIndex));
+            unsigned long long seenGeneration = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                wakeCondition.wait(lock, [&]{ return stopping || batchGeneration != seenGeneration; });
+                if(stopping) return;
+                seenGeneration = batchGeneration;
+                lock.unlock();
+                runChunks(threadIndex);
+                lock.lock();
+                if(--busyWorkers == 0) doneCondition.notify_one();
+            }
+        }
+
+        // Joins the workers when the program exits, since destroying a joinable std::thread terminates the program.
+        // It is declared after the state above so it is destroyed first (while the mutex and the conditions still exist).
+        struct ShutdownGuard {
+            ~ShutdownGuard() { if(initialized) JobSystem::shutdown(); }
+        } shutdownGuard;
+    }
+
+    void JobSystem::initialize(unsigned workerCount) {
+        if(initialized) shutdown();
+        if(workerCount == 0) {
+            // hardware_concurrency may return 0 if it can't tell, so we assume a single core in that case
+            unsigned cores = std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? cores - 1 : 0;
+        }
+        stopping = false;
+        // The main thread is thread 0 so the workers start from 1
+        for(unsigned index = 1; index <= workerCount; index++)
+            workers.emplace_back(workerLoop, index);
+        initialized = true;
+    }
+
+    void JobSystem::shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for(auto& worker : workers) worker.join();
+        workers.clear();
+        initialized = false;
+    }
+
+    unsigned JobSystem::getThreadCount() {
+        if(!initialized) initialize();
+        return (unsigned)workers.size() + 1;
+    }
+
+    void JobSystem::parallelFor(size_t count, size_t minChunkSize, const Job& job) {
+        if(count == 0) return;
+        if(!initialized) initialize();
+        // We make a few chunks per thread so that a thread that finishes early can help with the rest
+        size_t threadCount = workers.size() + 1;
+        size_t chunkSize = std::max<size_t>(std::max<size_t>(minChunkSize, 1), (count + threadCount * 4 - 1) / (threadCount * 4));
+        size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+        // If there is only one chunk (or no workers), waking the workers would cost more than it saves
+        if(chunkCount == 1 || workers.empty()) {
+            job(0, count, 0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batchJob = &job;
+            batchCount = count;
+            batchChunkSize = chunkSize;
+            batchChunkCount = chunkCount;
+            nextChunk = 0;
+            busyWorkers = (unsigned)workers.size();
+            batchGeneration++;
+        }
+        wakeCondition.notify_all();
+        runChunks(0);
+        // Wait for the workers to finish their chunks (the job must outlive the batch)
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, []{ return busyWorkers == 0; });
+        batchJob = nullptr;
+    }
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace our {
+
+    // A small pool of worker threads used to split CPU heavy loops (e.g. assigning lights to clusters) between the cores.
+    // The workers are created the first time they are needed and sleep while there is no work.
+    // The calling thread always takes part in the work, so "parallelFor" never runs slower than a plain loop
+    // on a single core machine (where no workers are created at all).
+    // WARNING: The jobs must not call OpenGL (the context is only current on the main thread)
+    // and "parallelFor" must only be called from one thread at a time (the main thread).
+    class JobSystem {
+    public:
+        // A job receives the range [begin, end) of the items it should process and the index of the thread running it.
+        // The thread index is in [0, getThreadCount()) so it can be used to give every thread its own output list.
+        using Job = std::function<void(size_t begin, size_t end, unsigned threadIndex)>;
+
+        // Starts the worker threads. If "workerCount" is 0, one worker is created for every core except the main one.
+        // Calling this is optional ("parallelFor" calls it if needed) but it allows choosing the number of workers.
+        static void initialize(unsigned workerCount = 0);
+        // Stops and joins the worker threads. This is done automatically when the program exits, but calling it
+        // earlier makes sure no worker outlives the data its jobs use.
+        static void shutdown();
+
+        // Returns the number of threads that may run jobs (the workers + the calling thread)
+        static unsigned getThreadCount();
+
+        // Splits [0, count) into chunks of at least "minChunkSize" items and runs the job on every chunk.
+        // It returns after all the chunks are done.
+        static void parallelFor(size_t count, size_t minChunkSize, const Job& job);
+    };
+
+}
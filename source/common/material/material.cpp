@@ -6,10 +6,11 @@
 namespace our {
 
     // This function should setup the pipeline state and set the shader to be used
-    void Material::setup() const {
+    void Material::setup(bool instanced) const {
         //TODO: (Req 6) Write this function
         pipelineState.setup();
-        shader->use();
+        getShader(instanced)->use();
+        FrameStats::countMaterialSetup();
     }
 
     // This function read the material data from a json object
@@ -20,15 +21,17 @@ namespace our {
             pipelineState.deserialize(data["pipelineState"]);
         }
         shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        // The instanced shader is optional, if it is missing, the material will not be drawn using instancing
+        instancedShader = AssetLoader<ShaderProgram>::get(data.value("instancedShader", ""));
         transparent = data.value("transparent", false);
     }
 
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint 
-    void TintedMaterial::setup() const {
+    void TintedMaterial::setup(bool instanced) const {
         //TODO: (Req 6) Write this function
-        Material::setup();
-        shader->set("tint",tint);
+        Material::setup(instanced);
+        getShader(instanced)->set("tint",tint);
     }
 
     // This function read the material data from a json object
@@ -38,11 +41,12 @@ namespace our {
         tint = data.value("tint", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
-    void TexturedMaterial::setup() const {
+    void TexturedMaterial::setup(bool instanced) const {
         //TODO: (Req 7) Write this function
-        TintedMaterial::setup(); //we call the tintedmaterial's setup that we just did
+        TintedMaterial::setup(instanced); //we call the tintedmaterial's setup that we just did
+        ShaderProgram* shader = getShader(instanced); // the shader that was selected by Material::setup
         shader->set("alphaThreshold",alphaThreshold); //we set the uniform alphathreshold to the value of the member alphaThreshold 
-        glActiveTexture(GL_TEXTURE0); // we select an active texture unit.
+        GLStateCache::activeTexture(0); // we select an active texture unit.
 
 
         if(texture)
@@ -67,41 +71,42 @@ namespace our {
     }
     //------------ lit material -------------------
 
-void LitMaterial::setup() const {
-    TexturedMaterial::setup();   // Call the setup function of the base class
+void LitMaterial::setup(bool instanced) const {
+    TexturedMaterial::setup(instanced);   // Call the setup function of the base class
+    ShaderProgram* shader = getShader(instanced);   // The shader that was selected by Material::setup
 
     // Bind and set the texture uniforms for each texture if they exist
     if (albedo) {
-        glActiveTexture(GL_TEXTURE0);
+        GLStateCache::activeTexture(0);
         albedo->bind();          // Bind the albedo texture
         sampler->bind(0);        // Bind the sampler to texture unit 0
         shader->set("material.albedo", 0);   // Set the "albedo" uniform in the shader to texture unit 0
     }
     if (specular) {
-        glActiveTexture(GL_TEXTURE1);
+        GLStateCache::activeTexture(1);
         specular->bind();        // Bind the specular texture
         sampler->bind(1);        // Bind the sampler to texture unit 1
         shader->set("material.specular", 1);  // Set the "specular" uniform in the shader to texture unit 1
     }
     if (ambient_occlusion) {
-        glActiveTexture(GL_TEXTURE2);
+        GLStateCache::activeTexture(2);
         ambient_occlusion->bind();   // Bind the ambient occlusion texture
         sampler->bind(2);            // Bind the sampler to texture unit 2
         shader->set("material.ambient_occlusion", 2);  // Set the "ambient_occlusion" uniform in the shader to texture unit 2
     }
     if (roughness) {
-        glActiveTexture(GL_TEXTURE3);
+        GLStateCache::activeTexture(3);
         roughness->bind();          // Bind the roughness texture
         sampler->bind(3);           // Bind the sampler to texture unit 3
         shader->set("material.roughness", 3);   // Set the "roughness" uniform in the shader to texture unit 3
     }
     if (emissive) {
-        glActiveTexture(GL_TEXTURE4);
+        GLStateCache::activeTexture(4);
         emissive->bind();           // Bind the emissive texture
         sampler->bind(4);           // Bind the sampler to texture unit 4
         shader->set("material.emissive", 4);    // Set the "emissive" uniform in the shader to texture unit 4
     }
-    glActiveTexture(GL_TEXTURE0);    // Reset the active texture to texture unit 0
+    GLStateCache::activeTexture(0);    // Reset the active texture to texture unit 0
 }
 
 // This function reads the material data from a json object
@@ -15,15 +15,23 @@ namespace our {
     // 1- The pipeline state when drawing objects using this material
     // 2- The shader program used to draw objects using this material
     // 3- Whether this material is transparent or not
+    // It can optionally hold an instanced variant of its shader which reads the model matrices from per-instance
+    // vertex attributes (see "InstanceData" in "mesh/vertex.hpp") instead of uniforms.
+    // Only materials that have it can be drawn by the renderer using hardware instancing.
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
     class Material {
     public:
         PipelineState pipelineState;
         ShaderProgram* shader;
+        ShaderProgram* instancedShader = nullptr;
         bool transparent;
+
+        // Returns the shader program to be used for regular draws or instanced draws
+        ShaderProgram* getShader(bool instanced) const { return instanced ? instancedShader : shader; }
         
         // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // If "instanced" is true, the instanced shader is used instead of the regular one
+        virtual void setup(bool instanced = false) const;
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
     };
@@ -34,7 +42,7 @@ namespace our {
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -49,7 +57,7 @@ namespace our {
         Sampler* sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -63,7 +71,7 @@ public:
     Texture2D* emissive;             // Emissive texture
     Sampler* sampler;                // Texture sampler
 
-    void setup() const override;     // Setup function for the material
+    void setup(bool instanced = false) const override;     // Setup function for the material
     void deserialize(const nlohmann::json& data) override;   // Deserialize function to populate the material from JSON data
 };
 
@@ -3,6 +3,7 @@
 #include <glad/gl.h>
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
+#include "../gl-state-cache.hpp"
 
 namespace our
 {
@@ -47,43 +48,45 @@ namespace our
         void setup() const
         {
             // TODO: (Req 3) Write this function
+            // All the calls go through the GLStateCache so that only the options that differ
+            // from the previously drawn material are sent to OpenGL
             ///check depth testing
             if (depthTesting.enabled)
             {
-                glEnable(GL_DEPTH_TEST); ///enable depth
-                glDepthFunc(depthTesting.function); 
-                glDepthMask(depthMask);
-                glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);///give color mask rgb color
+                GLStateCache::setCapability(GL_DEPTH_TEST, true); ///enable depth
+                GLStateCache::depthFunc(depthTesting.function);
+                GLStateCache::depthMask(depthMask);
+                GLStateCache::colorMask(colorMask);///give color mask rgb color
             }
             else
             {
 
-                glDisable(GL_DEPTH_TEST); ///disable depth testing
+                GLStateCache::setCapability(GL_DEPTH_TEST, false); ///disable depth testing
 
             }
             ///check face culling 
             if (faceCulling.enabled)
             {
-                glEnable(GL_CULL_FACE); ///enable face culling
-                glCullFace(faceCulling.culledFace);
-                glFrontFace(faceCulling.frontFace);
+                GLStateCache::setCapability(GL_CULL_FACE, true); ///enable face culling
+                GLStateCache::cullFace(faceCulling.culledFace);
+                GLStateCache::frontFace(faceCulling.frontFace);
             }
             else
             {
 
-                glDisable(GL_CULL_FACE);///disable face culling
+                GLStateCache::setCapability(GL_CULL_FACE, false);///disable face culling
             }
                ////check blending    
             if (blending.enabled) 
             {
-                glEnable(GL_BLEND);///enable blending
-                glBlendFunc(blending.sourceFactor, blending.destinationFactor);
-                 glBlendEquationSeparate(blending.equation,blending.equation);
-                 glBlendColor(blending.constantColor[0],blending.constantColor[1],blending.constantColor[2],blending.constantColor[3]);///give color mask rgb color
+                GLStateCache::setCapability(GL_BLEND, true);///enable blending
+                GLStateCache::blendFunc(blending.sourceFactor, blending.destinationFactor);
+                GLStateCache::blendEquation(blending.equation);
+                GLStateCache::blendColor(blending.constantColor);///give color mask rgb color
             }
             else
             {
-               glDisable(GL_BLEND);
+               GLStateCache::setCapability(GL_BLEND, false);
 
             }
         }
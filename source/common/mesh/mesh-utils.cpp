@@ -1,4 +1,5 @@
 #include "mesh-utils.hpp"
+#include "../cpu-profiler.hpp"
 
 // We will use "Tiny OBJ Loader" to read and process '.obj" files
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -7,8 +8,11 @@
 #include <iostream>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <cmath>
 
 our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+    PROFILE_SCOPE("mesh_utils::loadOBJ");
 
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
@@ -47,16 +51,21 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
                     attrib.vertices[3 * index.vertex_index + 2]
             };
 
-            vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-            };
+            // Some models have no normals or texture coordinates (their indices are -1), so they are left as zeros
+            if (index.normal_index >= 0) {
+                vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                };
+            }
 
-            vertex.tex_coord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1]
-            };
+            if (index.texcoord_index >= 0) {
+                vertex.tex_coord = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
 
 
             vertex.color = {
@@ -81,7 +90,11 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
         }
     }
 
-    return new our::Mesh(vertices, elements);
+    // Big meshes also get simplified levels of detail to draw when they are small on the screen
+    std::vector<std::vector<GLuint>> lods;
+    if (elements.size() / 3 >= MIN_LOD_TRIANGLES)
+        lods = generateLODs(vertices, elements);
+    return new our::Mesh(vertices, elements, lods);
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
@@ -120,4 +133,193 @@ our::Mesh* our::mesh_utils::sphere(const glm::ivec2& segments){
     }
 
     return new our::Mesh(vertices, elements);
-}
\ No newline at end of file
+}
+namespace {
+    // A quadric stores the sum of the squared distances from a point to a set of planes as a symmetric 4x4 matrix
+    // (only the 10 unique values are stored). Adding the quadrics of two vertices gives the quadric of both plane sets.
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+
+        void addPlane(const glm::dvec4& p) {
+            a00 += p.x * p.x; a01 += p.x * p.y; a02 += p.x * p.z; a03 += p.x * p.w;
+            a11 += p.y * p.y; a12 += p.y * p.z; a13 += p.y * p.w;
+            a22 += p.z * p.z; a23 += p.z * p.w;
+            a33 += p.w * p.w;
+        }
+        void add(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+        }
+        // Returns the sum of the squared distances from the point to the planes
+        double error(const glm::dvec3& v) const {
+            return a00 * v.x * v.x + 2 * a01 * v.x * v.y + 2 * a02 * v.x * v.z + 2 * a03 * v.x
+                 + a11 * v.y * v.y + 2 * a12 * v.y * v.z + 2 * a13 * v.y
+                 + a22 * v.z * v.z + 2 * a23 * v.z
+                 + a33;
+        }
+    };
+
+    // A possible collapse of the vertex "from" onto the vertex "to" (both are vertex indices, not positions)
+    struct Collapse {
+        GLuint from, to;
+        double cost;
+    };
+}
+
+std::vector<GLuint> our::mesh_utils::simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements,
+                                              size_t targetTriangles, float* resultError) {
+    size_t vertexCount = vertices.size();
+
+    // The vertices that share a position (but differ in their normal, texture coordinates, etc.) are "wedges" of the same
+    // corner, so the topology is built over the unique positions ("corner" maps every vertex to its first wedge)
+    std::vector<GLuint> corner(vertexCount);
+    std::vector<uint32_t> wedgeCount(vertexCount, 0);
+    {
+        std::unordered_map<glm::vec3, GLuint> positions;
+        for (GLuint index = 0; index < vertexCount; index++) {
+            corner[index] = positions.emplace(vertices[index].position, index).first->second;
+            wedgeCount[corner[index]]++;
+        }
+    }
+
+    // The corners on a seam (more than one wedge), a border (an edge used by one triangle)
+    // or a non-manifold edge (used by more than two triangles) are locked in place
+    std::vector<bool> locked(vertexCount, false);
+    for (GLuint index = 0; index < vertexCount; index++)
+        if (wedgeCount[corner[index]] > 1) locked[corner[index]] = true;
+    {
+        std::unordered_map<uint64_t, int> edgeUses;
+        for (size_t i = 0; i + 2 < elements.size(); i += 3)
+            for (int e = 0; e < 3; e++) {
+                uint64_t a = corner[elements[i + e]], b = corner[elements[i + (e + 1) % 3]];
+                edgeUses[a < b ? (a << 32 | b) : (b << 32 | a)]++;
+            }
+        for (auto& [edge, uses] : edgeUses)
+            if (uses != 2) {
+                locked[edge >> 32] = true;
+                locked[edge & 0xFFFFFFFF] = true;
+            }
+    }
+
+    // Every corner starts with the planes of the triangles around it
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < elements.size(); i += 3) {
+        glm::dvec3 p0 = vertices[elements[i]].position, p1 = vertices[elements[i + 1]].position, p2 = vertices[elements[i + 2]].position;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length <= 0) continue;
+        normal /= length;
+        Quadric plane;
+        plane.addPlane(glm::dvec4(normal, -glm::dot(normal, p0)));
+        for (int k = 0; k < 3; k++) quadrics[corner[elements[i + k]]].add(plane);
+    }
+
+    std::vector<GLuint> result = elements;
+    double maxCost = 0;
+    std::vector<GLuint> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<uint32_t> triangleStarts(vertexCount + 1);
+    std::vector<uint32_t> cornerTriangles;
+    std::vector<Collapse> collapses;
+
+    // The collapses are done in passes: every pass sorts all the possible collapses by their cost and does the cheapest
+    // ones as long as they don't touch the neighbourhood of a collapse done earlier in the same pass
+    while (result.size() / 3 > targetTriangles) {
+        size_t triangleCount = result.size() / 3;
+
+        // List the triangles around every corner (counting first, then filling)
+        std::fill(triangleStarts.begin(), triangleStarts.end(), 0);
+        for (GLuint index : result) triangleStarts[corner[index] + 1]++;
+        for (size_t i = 1; i <= vertexCount; i++) triangleStarts[i] += triangleStarts[i - 1];
+        cornerTriangles.resize(result.size());
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++) cornerTriangles[triangleStarts[corner[result[3 * t + k]]]++] = (uint32_t)t;
+        for (size_t i = vertexCount; i > 0; i--) triangleStarts[i] = triangleStarts[i - 1];
+        triangleStarts[0] = 0;
+
+        // Every edge can be collapsed in both directions unless the moving corner is locked
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++) {
+                GLuint a = result[3 * t + k], b = result[3 * t + (k + 1) % 3];
+                GLuint ca = corner[a], cb = corner[b];
+                Quadric sum = quadrics[ca];
+                sum.add(quadrics[cb]);
+                if (!locked[ca]) collapses.push_back({a, b, sum.error(vertices[cb].position)});
+                if (!locked[cb]) collapses.push_back({b, a, sum.error(vertices[ca].position)});
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& first, const Collapse& second) { return first.cost < second.cost; });
+
+        for (GLuint index = 0; index < vertexCount; index++) remap[index] = index;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removed = 0, removable = triangleCount - targetTriangles;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= removable) break;
+            GLuint from = corner[collapse.from], to = corner[collapse.to];
+            if (touched[from] || touched[to]) continue;
+
+            // Reject the collapse if it flips any of the triangles that survive it
+            glm::vec3 target = vertices[to].position;
+            bool flips = false;
+            size_t degenerate = 0;
+            for (uint32_t slot = triangleStarts[from]; slot < triangleStarts[from + 1] && !flips; slot++) {
+                const GLuint* triangle = &result[3 * cornerTriangles[slot]];
+                glm::vec3 p[3];
+                bool hasTarget = false;
+                for (int k = 0; k < 3; k++) {
+                    p[k] = vertices[triangle[k]].position;
+                    hasTarget |= corner[triangle[k]] == to;
+                }
+                if (hasTarget) { degenerate++; continue; }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (int k = 0; k < 3; k++) if (corner[triangle[k]] == from) p[k] = target;
+                glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                flips = glm::dot(before, after) <= 0;
+            }
+            if (flips) continue;
+
+            // The moving corner has a single wedge (otherwise it would be locked) and the wedge of the target is the one
+            // used by the triangles on the collapsed edge
+            remap[collapse.from] = collapse.to;
+            quadrics[to].add(quadrics[from]);
+            maxCost = std::max(maxCost, collapse.cost);
+            removed += degenerate;
+            // Lock the whole neighbourhood for the rest of this pass since its triangles just changed
+            for (uint32_t slot = triangleStarts[from]; slot < triangleStarts[from + 1]; slot++)
+                for (int k = 0; k < 3; k++) touched[corner[result[3 * cornerTriangles[slot] + k]]] = true;
+        }
+        if (removed == 0) break;
+
+        // Apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            GLuint a = remap[result[3 * t]], b = remap[result[3 * t + 1]], c = remap[result[3 * t + 2]];
+            if (corner[a] == corner[b] || corner[b] == corner[c] || corner[c] == corner[a]) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError) *resultError = (float)std::sqrt(maxCost);
+    return result;
+}
+
+std::vector<std::vector<GLuint>> our::mesh_utils::generateLODs(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, int levels) {
+    std::vector<std::vector<GLuint>> lods;
+    // Reserving the levels keeps "previous" valid while we add them
+    lods.reserve(levels);
+    const std::vector<GLuint>* previous = &elements;
+    for (int level = 0; level < levels; level++) {
+        size_t triangles = previous->size() / 3;
+        // Every level is simplified from the one before it, so the levels look alike and the bake stays fast
+        std::vector<GLuint> lod = simplify(vertices, *previous, triangles / 2);
+        if (lod.size() / 3 > triangles * 3 / 4) break;
+        lods.push_back(std::move(lod));
+        previous = &lods.back();
+    }
+    return lods;
+}
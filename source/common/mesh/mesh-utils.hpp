@@ -9,4 +9,18 @@ namespace our::mesh_utils {
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
+
+    // Meshes with fewer triangles than this are cheap enough to always draw at full detail
+    constexpr size_t MIN_LOD_TRIANGLES = 256;
+    // Simplifies the mesh using edge collapses ordered by their quadric error (Garland & Heckbert)
+    // Every collapse moves a vertex onto one of its neighbours, so the result is a new element list that uses
+    // a subset of the same vertices. The vertices on the mesh borders and seams (where the normals or the texture
+    // coordinates are split) never move so that the silhouette and the texture mapping stay intact.
+    // It stops when the mesh has at most "targetTriangles" triangles or when no collapse is left.
+    // If "resultError" is given, it receives the largest error (a distance in the mesh space) of the done collapses.
+    std::vector<GLuint> simplify(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements,
+                                 size_t targetTriangles, float* resultError = nullptr);
+    // Generates up to "levels" levels of detail where every level has about half the triangles of the one before it
+    // A level that can't be simplified enough (less than 25% fewer triangles) ends the list.
+    std::vector<std::vector<GLuint>> generateLODs(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, int levels = 3);
 }
\ No newline at end of file
@@ -2,7 +2,12 @@
 
 #include <glad/gl.h>
 #include "vertex.hpp"
+#include "../gl-state-cache.hpp"
+#include "../frame-stats.hpp"
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cfloat>
 
 namespace our {
 
@@ -10,6 +15,9 @@ namespace our {
     #define ATTRIB_LOC_COLOR    1
     #define ATTRIB_LOC_TEXCOORD 2
     #define ATTRIB_LOC_NORMAL   3
+    // A mat4 attribute takes 4 locations (one per column) so these two take the locations 4 to 11
+    #define ATTRIB_LOC_INSTANCE_M    4
+    #define ATTRIB_LOC_INSTANCE_M_IT 8
 
     class Mesh {
         // Here, we store the object names of the 3 main components of a mesh:
@@ -19,6 +27,11 @@ namespace our {
         unsigned int VAO; ///vertex array object
         // We need to remember the number of elements that will be draw by glDrawElements 
         GLsizei elementCount;
+        // The levels of detail share the vertex buffer and are stored one after the other in the element buffer
+        // Level 0 is the full mesh, then every level has fewer triangles than the one before it
+        std::vector<GLsizei> lodOffsets, lodCounts;
+        // Whether the per-instance attributes of the vertex array are enabled (they are set up the first time an instance buffer is bound)
+        bool instanceAttributesEnabled = false;
     public:
 
         // save the max and min values for the vertices in order to use them to calculate the center of 
@@ -34,7 +47,9 @@ namespace our {
         // a vertex buffer to store the vertex data on the VRAM,
         // an element buffer to store the element data on the VRAM,
         // a vertex array object to define how to read the vertex & element buffer during rendering 
-        Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements)
+        // The optional "lods" are the elements of the simplified versions of the mesh (see "mesh_utils::generateLODs")
+        Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements,
+             const std::vector<std::vector<unsigned int>>& lods = {})
         {
             // calculate the values of the mesh boundries
             calculateMinMaxPoints(vertices);
@@ -45,7 +60,7 @@ namespace our {
             //Vertex array generate
               glGenVertexArrays(1, &VAO);
               //Vertex array generate bind
-              glBindVertexArray(VAO);
+              GLStateCache::bindVertexArray(VAO);
              //vertex buffer generate 
                glGenBuffers(1, &VBO);
                 //vertex buffer generate bind
@@ -70,8 +85,21 @@ namespace our {
                 // Element buffer generate and bind
                glGenBuffers(1, &EBO);
                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-               glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount*sizeof(unsigned int), &elements[0], GL_STATIC_DRAW);
-               glBindVertexArray(0); 
+               // The full mesh comes first then the levels of detail are appended after it
+               lodOffsets.push_back(0);
+               lodCounts.push_back(elementCount);
+               GLsizei totalCount = elementCount;
+               for(auto& lod : lods){
+                   lodOffsets.push_back(totalCount);
+                   lodCounts.push_back((GLsizei)lod.size());
+                   totalCount += (GLsizei)lod.size();
+               }
+               glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalCount*sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+               glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, elementCount*sizeof(unsigned int), elements.data());
+               for(size_t level = 0; level < lods.size(); ++level)
+                   glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, lodOffsets[level + 1]*sizeof(unsigned int),
+                                   lods[level].size()*sizeof(unsigned int), lods[level].data());
+               GLStateCache::bindVertexArray(0);
 
             // remember to store the number of elements in "elementCount" since you will need it for drawing
             // For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
@@ -86,49 +114,122 @@ namespace our {
         */
         void calculateMinMaxPoints(const std::vector<Vertex>& vertices)
         {
-            minX = FLT_MAX;
-            maxX = FLT_MIN;
-            minY = FLT_MAX;
-            maxY = FLT_MIN;
-            minZ = FLT_MAX;
-            maxZ = FLT_MIN;
+            // The bounds are used for culling, so every axis is checked on its own
+            // (the lowest float is -FLT_MAX, FLT_MIN is the smallest positive float)
+            minX = minY = minZ = FLT_MAX;
+            maxX = maxY = maxZ = -FLT_MAX;
             for(auto vertex : vertices)
             {
                 glm::vec3 pos = vertex.position;
-                if(pos[0] > maxX)
-                maxX = pos[0];
-                else if(pos[0] < minX)
-                minX = pos[0];
-
-                if(pos[1] > maxY)
-                maxY = pos[1];
-                else if(pos[1] < minY)
-                minY = pos[1];
-
-                if(pos[2] > maxZ)
-                maxZ = pos[2];
-                else if(pos[2] < minZ)
-                minZ = pos[2];
+                minX = std::min(minX, pos[0]);
+                maxX = std::max(maxX, pos[0]);
+                minY = std::min(minY, pos[1]);
+                maxY = std::max(maxY, pos[1]);
+                minZ = std::min(minZ, pos[2]);
+                maxZ = std::max(maxZ, pos[2]);
             }
+            if(vertices.empty()) minX = minY = minZ = maxX = maxY = maxZ = 0;
         }
 
-        // this function should render the mesh
-        void draw() 
+        // Returns the center and the radius of a sphere enclosing the mesh bounding box (in the mesh local space)
+        glm::vec4 getBoundingSphere() const
+        {
+            glm::vec3 min(minX, minY, minZ), max(maxX, maxY, maxZ);
+            return glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+        }
+
+        // Returns the number of levels of detail (including the full mesh at level 0)
+        int getLODCount() const { return (int)lodCounts.size(); }
+        // Returns the number of elements drawn at the given level of detail
+        GLsizei getElementCount(int lod = 0) const { return lodCounts[clampLOD(lod)]; }
+        // Returns the given level clamped to the levels this mesh has
+        int clampLOD(int lod) const { return std::clamp(lod, 0, (int)lodCounts.size() - 1); }
+
+        // this function should render the mesh (at the given level of detail)
+        void draw(int lod = 0) 
         {
            
             //TODO: (Req 1) Write this function
           
-             ///bind vertex array       
-            glBindVertexArray(VAO); 
+             ///bind vertex array (skipped by the state cache if it is already bound)
+            GLStateCache::bindVertexArray(VAO);
             ///draw elements in screen 
-           glDrawElements(GL_TRIANGLES,  elementCount, GL_UNSIGNED_INT, (void*)0);
+            lod = clampLOD(lod);
+           glDrawElements(GL_TRIANGLES, lodCounts[lod], GL_UNSIGNED_INT, (void*)(lodOffsets[lod] * sizeof(unsigned int)));
+           FrameStats::countDraw(lodCounts[lod] / 3);
               
         }
 
+        // This function reads the vertex & element data back from the VRAM since the mesh doesn't keep a copy on the RAM
+        // It stalls until the GPU is done with the buffers, so it should only be used while loading (e.g. static batching)
+        // The elements are read from the given level of detail
+        void readBack(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements, int lod = 0) const
+        {
+            // We use the copy-read target since binding to GL_ELEMENT_ARRAY_BUFFER would change the bound vertex array
+            GLint size = 0;
+            glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+            glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+            vertices.resize(size / sizeof(Vertex));
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+
+            lod = clampLOD(lod);
+            elements.resize(lodCounts[lod]);
+            glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, lodOffsets[lod] * sizeof(unsigned int), elements.size() * sizeof(unsigned int), elements.data());
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+
+        // Returns the size of the vertex & element buffers in bytes (asked from OpenGL, so it shouldn't be called for every draw)
+        size_t getMemorySize() const
+        {
+            GLint vertexBytes = 0, elementBytes = 0;
+            glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+            glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &vertexBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, EBO);
+            glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &elementBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            return (size_t)vertexBytes + (size_t)elementBytes;
+        }
+
+        // This function makes the vertex array read the per-instance attributes (see "InstanceData")
+        // from the given buffer starting at the given offset (in bytes).
+        // The attributes advance once per instance instead of once per vertex (divisor = 1).
+        // The instances are written to a different part of a stream buffer every time (see "stream-buffer.hpp"),
+        // so the attribute pointers are always set, but enabling the attributes is only done once.
+        void bindInstanceBuffer(GLuint buffer, GLintptr offset = 0)
+        {
+            GLStateCache::bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            for(GLuint column = 0; column < 4; ++column)
+            {
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_M + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                    (void*)(offset + offsetof(InstanceData, M) + column * sizeof(glm::vec4)));
+                glVertexAttribPointer(ATTRIB_LOC_INSTANCE_M_IT + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                    (void*)(offset + offsetof(InstanceData, M_IT) + column * sizeof(glm::vec4)));
+                if(instanceAttributesEnabled) continue;
+                glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_M + column);
+                glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_M + column, 1);
+                glEnableVertexAttribArray(ATTRIB_LOC_INSTANCE_M_IT + column);
+                glVertexAttribDivisor(ATTRIB_LOC_INSTANCE_M_IT + column, 1);
+            }
+            instanceAttributesEnabled = true;
+        }
+
+        // this function renders "instanceCount" copies of the mesh (at the given level of detail) in a single draw call
+        // The instance buffer must be bound first using "bindInstanceBuffer"
+        void drawInstanced(GLsizei instanceCount, int lod = 0)
+        {
+            GLStateCache::bindVertexArray(VAO);
+            lod = clampLOD(lod);
+            glDrawElementsInstanced(GL_TRIANGLES, lodCounts[lod], GL_UNSIGNED_INT, (void*)(lodOffsets[lod] * sizeof(unsigned int)), instanceCount);
+            FrameStats::countDraw((std::uint64_t)instanceCount * (lodCounts[lod] / 3));
+        }
+
         // this function should delete the vertex & element buffers and the vertex array object
         ~Mesh(){
             //TODO: (Req 1) Write this function
             glDeleteVertexArrays(1, &VAO); ///delete VAO
+            GLStateCache::forgetVertexArray(VAO);
             glDeleteBuffers(1, &VBO); ///delete VBO
             glDeleteBuffers(1, &EBO); ///delete EBO
         }
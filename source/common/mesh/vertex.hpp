@@ -24,6 +24,13 @@ namespace our {
         }
     };
 
+    // When a mesh is drawn using hardware instancing, the data that differs between the instances
+    // is read from an instance buffer (one element per instance) instead of uniforms
+    struct InstanceData {
+        glm::mat4 M;            // The model matrix (local to world) of the instance
+        glm::mat4 M_IT;         // The inverse-transpose of the model matrix (used to transform the normals)
+    };
+
 }
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
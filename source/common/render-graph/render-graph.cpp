@@ -0,0 +1,146 @@
+#include "render-graph.hpp"
+
+#include <cassert>
+
+namespace our {
+
+    RenderResource RenderGraph::PassBuilder::create(const std::string& name, const RenderTargetDesc& desc) {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        graph.resources.push_back(resource);
+        return write((RenderResource)graph.resources.size() - 1);
+    }
+
+    RenderResource RenderGraph::PassBuilder::read(RenderResource resource) {
+        graph.passes[pass].reads.push_back(resource);
+        return resource;
+    }
+
+    RenderResource RenderGraph::PassBuilder::write(RenderResource resource) {
+        graph.passes[pass].writes.push_back(resource);
+        return resource;
+    }
+
+    void RenderGraph::PassBuilder::setSideEffect() {
+        graph.passes[pass].sideEffect = true;
+    }
+
+    RenderResource RenderGraph::importFramebuffer(const std::string& name, GLuint framebuffer, glm::ivec2 size) {
+        Resource resource;
+        resource.name = name;
+        resource.desc.size = size;
+        resource.imported = true;
+        resource.framebuffer = framebuffer;
+        resources.push_back(resource);
+        return (RenderResource)resources.size() - 1;
+    }
+
+    void RenderGraph::addPass(const std::string& name, const Setup& setup, const Execute& execute) {
+        Pass pass;
+        pass.name = name;
+        pass.execute = execute;
+        passes.push_back(pass);
+        PassBuilder builder(*this, (int)passes.size() - 1);
+        setup(builder);
+    }
+
+    void RenderGraph::compile() {
+        // A pass is needed if it has side effects, writes an imported resource or writes something that a needed pass reads
+        // So we count the readers of every resource, then we cull the passes whose outputs have no readers and release
+        // what they read (which may make the passes before them useless too)
+        for(auto& resource : resources) resource.readers = 0;
+        for(auto& pass : passes)
+            for(RenderResource resource : pass.reads) resources[resource].readers++;
+        std::vector<int> unused;
+        for(int index = 0; index < (int)passes.size(); index++) {
+            Pass& pass = passes[index];
+            pass.culled = false;
+            pass.references = pass.sideEffect ? 1 : 0;
+            for(RenderResource resource : pass.writes)
+                if(resources[resource].imported || resources[resource].readers > 0) pass.references++;
+            if(pass.references == 0) unused.push_back(index);
+        }
+        while(!unused.empty()) {
+            Pass& pass = passes[unused.back()];
+            unused.pop_back();
+            pass.culled = true;
+            for(RenderResource read : pass.reads) {
+                Resource& resource = resources[read];
+                if(--resource.readers > 0 || resource.imported) continue;
+                // Nothing reads this resource anymore, so the passes writing it lose a reference
+                for(int index = 0; index < (int)passes.size(); index++) {
+                    Pass& writer = passes[index];
+                    if(writer.culled) continue;
+                    for(RenderResource write : writer.writes)
+                        if(write == read && --writer.references == 0) unused.push_back(index);
+                }
+            }
+        }
+
+        // The lifetime of every resource goes from the first to the last pass (that was not culled) using it
+        for(auto& resource : resources) resource.firstPass = resource.lastPass = -1;
+        for(int index = 0; index < (int)passes.size(); index++) {
+            const Pass& pass = passes[index];
+            if(pass.culled) continue;
+            for(const auto* list : {&pass.reads, &pass.writes})
+                for(RenderResource id : *list) {
+                    Resource& resource = resources[id];
+                    if(resource.firstPass < 0) resource.firstPass = index;
+                    resource.lastPass = index;
+                }
+        }
+    }
+
+    void RenderGraph::execute(RenderTargetPool& pool) {
+        pool.beginFrame();
+        PassResources passResources(*this);
+        for(int index = 0; index < (int)passes.size(); index++) {
+            Pass& pass = passes[index];
+            if(pass.culled) continue;
+            // The textures are only taken from the pool when they start being used
+            for(auto& resource : resources)
+                if(!resource.imported && resource.firstPass == index) resource.texture = pool.acquire(resource.desc);
+
+            // Bind the framebuffer the pass draws to (either an imported one or one made of the written textures)
+            Texture2D *color = nullptr, *depth = nullptr;
+            GLuint framebuffer = 0;
+            bool imported = false;
+            glm::ivec2 size(0);
+            for(RenderResource id : pass.writes) {
+                const Resource& resource = resources[id];
+                size = resource.desc.size;
+                if(resource.imported) {
+                    framebuffer = resource.framebuffer;
+                    imported = true;
+                } else if(resource.desc.isDepth()) {
+                    depth = resource.texture;
+                } else {
+                    color = resource.texture;
+                }
+            }
+            // An imported framebuffer comes with its own attachments, so it can't be mixed with transient textures
+            assert(!imported || (!color && !depth));
+            if(!pass.writes.empty()) {
+                if(!imported) framebuffer = pool.getFramebuffer(color, depth);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+                glViewport(0, 0, size.x, size.y);
+            }
+
+            pass.execute(passResources);
+
+            // The textures whose last pass is done go back to the pool, so the next passes may reuse them
+            for(auto& resource : resources)
+                if(resource.texture && resource.lastPass == index) {
+                    pool.release(resource.texture);
+                    resource.texture = nullptr;
+                }
+        }
+    }
+
+    void RenderGraph::clear() {
+        resources.clear();
+        passes.clear();
+    }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "render-target-pool.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // A render resource is the index of a texture (or an imported framebuffer) in the render graph
+    using RenderResource = int;
+    constexpr RenderResource NO_RENDER_RESOURCE = -1;
+
+    // A render graph describes the passes of a frame by the resources that every pass reads and writes
+    // Instead of creating framebuffers and textures by hand for every effect, the renderer adds its passes every frame,
+    // then the graph:
+    //  - culls the passes whose outputs are never used (unless they are marked as having side effects),
+    //  - finds the first and the last pass that use every transient texture,
+    //  - acquires the textures from a pool right before their first pass and releases them right after their last one,
+    //    so the textures whose lifetimes don't overlap share the same memory,
+    //  - binds a framebuffer with the written textures (and sets the viewport) before running every pass.
+    // The passes run in the order they were added. Every pass may write at most one color and one depth resource.
+    class RenderGraph {
+    public:
+        // Used by the "setup" function of a pass to declare what it reads and writes
+        class PassBuilder {
+            friend class RenderGraph;
+            RenderGraph& graph;
+            int pass;
+            PassBuilder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+        public:
+            // Creates a transient texture that is written by this pass
+            RenderResource create(const std::string& name, const RenderTargetDesc& desc);
+            // Declares that this pass reads (samples) the given resource
+            RenderResource read(RenderResource resource);
+            // Declares that this pass draws to the given resource
+            RenderResource write(RenderResource resource);
+            // Prevents the pass from being culled even if nothing reads its outputs
+            void setSideEffect();
+        };
+
+        // Gives the "execute" function of a pass the textures of its resources
+        class PassResources {
+            friend class RenderGraph;
+            const RenderGraph& graph;
+            explicit PassResources(const RenderGraph& graph) : graph(graph) {}
+        public:
+            Texture2D* getTexture(RenderResource resource) const { return graph.resources[resource].texture; }
+            glm::ivec2 getSize(RenderResource resource) const { return graph.resources[resource].desc.size; }
+        };
+
+        using Setup = std::function<void(PassBuilder&)>;
+        using Execute = std::function<void(const PassResources&)>;
+
+    private:
+        struct Resource {
+            std::string name;
+            RenderTargetDesc desc;
+            bool imported = false;
+            GLuint framebuffer = 0;         // The framebuffer of an imported resource
+            Texture2D* texture = nullptr;   // The pooled texture of a transient resource (only while it is alive)
+            int firstPass = -1, lastPass = -1;
+            int readers = 0;
+        };
+        struct Pass {
+            std::string name;
+            Execute execute;
+            std::vector<RenderResource> reads, writes;
+            bool sideEffect = false;
+            bool culled = false;
+            int references = 0;
+        };
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+
+    public:
+        // Adds a resource that lives outside the graph (e.g. the window) which is drawn to through the given framebuffer
+        // The passes writing to an imported resource are never culled
+        RenderResource importFramebuffer(const std::string& name, GLuint framebuffer, glm::ivec2 size);
+        // Adds a pass: "setup" is called right away to declare its resources and "execute" is called by "execute"
+        void addPass(const std::string& name, const Setup& setup, const Execute& execute);
+        // Culls the unused passes and computes the lifetimes of the transient resources
+        void compile();
+        // Runs the passes that were not culled, acquiring and releasing their textures from the pool
+        void execute(RenderTargetPool& pool);
+        // Removes all the passes and the resources (so the graph of the next frame can be added)
+        void clear();
+
+        int getPassCount() const { return (int)passes.size(); }
+        const std::string& getPassName(int pass) const { return passes[pass].name; }
+        bool isCulled(int pass) const { return passes[pass].culled; }
+    };
+
+}
@@ -0,0 +1,99 @@
+#include "render-target-pool.hpp"
+
+namespace our {
+
+    size_t RenderTargetDesc::getByteSize() const {
+        size_t texelSize = 4;
+        switch(format) {
+            case GL_R8: texelSize = 1; break;
+            case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: texelSize = 2; break;
+            case GL_RGB8: texelSize = 3; break;
+            case GL_RGBA16F: texelSize = 8; break;
+            case GL_RGBA32F: texelSize = 16; break;
+            default: texelSize = 4; break;
+        }
+        return (size_t)size.x * size.y * texelSize;
+    }
+
+    void RenderTargetPool::beginFrame() {
+        frame++;
+        for(size_t index = 0; index < entries.size();) {
+            Entry& entry = entries[index];
+            if(!entry.inUse && frame - entry.lastUsedFrame > MAX_UNUSED_FRAMES) {
+                forgetFramebuffers(entry.texture->getOpenGLName());
+                delete entry.texture;
+                entry = entries.back();
+                entries.pop_back();
+            } else {
+                index++;
+            }
+        }
+    }
+
+    Texture2D* RenderTargetPool::acquire(const RenderTargetDesc& desc) {
+        for(auto& entry : entries) {
+            if(!entry.inUse && entry.desc == desc) {
+                entry.inUse = true;
+                entry.lastUsedFrame = frame;
+                return entry.texture;
+            }
+        }
+        // Render targets are never sampled with mipmaps, so a single level is enough
+        auto texture = new Texture2D();
+        texture->bind();
+        glTexStorage2D(GL_TEXTURE_2D, 1, desc.format, desc.size.x, desc.size.y);
+        entries.push_back({desc, texture, true, frame});
+        return texture;
+    }
+
+    void RenderTargetPool::release(Texture2D* texture) {
+        for(auto& entry : entries) {
+            if(entry.texture == texture) {
+                entry.inUse = false;
+                entry.lastUsedFrame = frame;
+                return;
+            }
+        }
+    }
+
+    GLuint RenderTargetPool::getFramebuffer(Texture2D* color, Texture2D* depth) {
+        std::pair<GLuint, GLuint> key(color ? color->getOpenGLName() : 0, depth ? depth->getOpenGLName() : 0);
+        auto it = framebuffers.find(key);
+        if(it != framebuffers.end()) return it->second;
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, key.first, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, key.second, 0);
+        // A depth-only framebuffer must not try to draw any color
+        GLenum drawBuffer = color ? GL_COLOR_ATTACHMENT0 : GL_NONE;
+        glDrawBuffers(1, &drawBuffer);
+        framebuffers.emplace(key, framebuffer);
+        return framebuffer;
+    }
+
+    void RenderTargetPool::forgetFramebuffers(GLuint texture) {
+        for(auto it = framebuffers.begin(); it != framebuffers.end();) {
+            if(it->first.first == texture || it->first.second == texture) {
+                glDeleteFramebuffers(1, &it->second);
+                it = framebuffers.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void RenderTargetPool::clear() {
+        for(auto& [key, framebuffer] : framebuffers) glDeleteFramebuffers(1, &framebuffer);
+        framebuffers.clear();
+        for(auto& entry : entries) delete entry.texture;
+        entries.clear();
+    }
+
+    size_t RenderTargetPool::getByteSize() const {
+        size_t size = 0;
+        for(auto& entry : entries) size += entry.desc.getByteSize();
+        return size;
+    }
+
+}
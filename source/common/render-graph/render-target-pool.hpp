@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../texture/texture2d.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <map>
+#include <utility>
+
+namespace our {
+
+    // Describes a render target texture: its size in pixels and its internal format (e.g. GL_RGBA8 or GL_DEPTH_COMPONENT24)
+    struct RenderTargetDesc {
+        glm::ivec2 size = {0, 0};
+        GLenum format = GL_RGBA8;
+
+        bool operator==(const RenderTargetDesc& other) const { return size == other.size && format == other.format; }
+        bool isDepth() const { return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8; }
+        // Returns the (approximate) number of bytes used by a texture with this description
+        size_t getByteSize() const;
+    };
+
+    // A pool of render target textures that are reused between the passes and the frames
+    // The render graph acquires a texture when a transient resource is first written and releases it after its last
+    // reader, so two resources that are never alive at the same time share the same texture (and the same VRAM).
+    // The textures that are not used for a few frames (e.g. after resizing the window) are deleted.
+    class RenderTargetPool {
+    public:
+        // A released texture is deleted if it isn't acquired again for this many frames
+        static constexpr int MAX_UNUSED_FRAMES = 3;
+
+    private:
+        struct Entry {
+            RenderTargetDesc desc;
+            Texture2D* texture;
+            bool inUse;
+            int lastUsedFrame;
+        };
+        std::vector<Entry> entries;
+        int frame = 0;
+        // The framebuffers used to draw to the textures, by the names of their color and depth attachments
+        std::map<std::pair<GLuint, GLuint>, GLuint> framebuffers;
+
+        // Deletes the framebuffers that have the given texture attached
+        void forgetFramebuffers(GLuint texture);
+
+    public:
+        // Deletes the textures that were not used for a while, this should be called once per frame
+        void beginFrame();
+        // Returns a free texture with the given description (creating one if there is none)
+        Texture2D* acquire(const RenderTargetDesc& desc);
+        // Returns the texture to the pool so that it can be acquired again (in this frame or in the next ones)
+        void release(Texture2D* texture);
+        // Returns a framebuffer with the given textures attached (any of them can be null)
+        GLuint getFramebuffer(Texture2D* color, Texture2D* depth);
+        // Deletes all the textures and the framebuffers (this must be called while the OpenGL context still exists)
+        void clear();
+
+        size_t getTextureCount() const { return entries.size(); }
+        // Returns the number of bytes used by all the textures of the pool
+        size_t getByteSize() const;
+    };
+
+}
@@ -0,0 +1,210 @@
+#include "scene-generator.hpp"
+#include "deserialize-utils.hpp"
+
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+namespace our {
+
+    namespace {
+
+        // The assets shared by every generated scene (the generated materials are added to them)
+        const char* SHARED_ASSETS = R"({
+            "shaders": {
+                "textured": {"vs": "assets/shaders/textured.vert", "fs": "assets/shaders/textured.frag"},
+                "textured-instanced": {"vs": "assets/shaders/textured-instanced.vert", "fs": "assets/shaders/textured.frag"},
+                "lighted": {"vs": "assets/shaders/lighted.vert", "fs": "assets/shaders/lighted.frag"},
+                "lighted-instanced": {"vs": "assets/shaders/lighted-instanced.vert", "fs": "assets/shaders/lighted.frag"}
+            },
+            "textures": {
+                "wall": "assets/textures/brickwall_4.jpg",
+                "floor": "assets/textures/TopSeamless.png",
+                "scarecrow": "assets/textures/wood.jpg",
+                "glass": "assets/textures/glass-panels.png",
+                "white": "assets/textures/white.jpg",
+                "roughness": "assets/textures/roughness.jpg",
+                "black": "assets/textures/black.jpg"
+            },
+            "meshes": {
+                "wall": "assets/models/AncientWallFBX.obj",
+                "plane": "assets/models/plane.obj",
+                "scarecrow": "assets/models/Scarecrow.obj"
+            },
+            "samplers": {
+                "default": {},
+                "pixelated": {"MAG_FILTER": "GL_NEAREST"}
+            },
+            "materials": {
+                "floor": {
+                    "type": "lighted", "shader": "lighted",
+                    "pipelineState": {"faceCulling": {"enabled": false}, "depthTesting": {"enabled": true}},
+                    "tint": [1, 1, 1, 1], "sampler": "default",
+                    "albedo": "floor", "roughness": "roughness", "specular": "white", "ambient_occlusion": "black"
+                },
+                "scarecrow": {
+                    "type": "textured", "shader": "textured", "instancedShader": "textured-instanced",
+                    "pipelineState": {"faceCulling": {"enabled": false}, "depthTesting": {"enabled": true}},
+                    "tint": [1, 1, 1, 1], "texture": "scarecrow", "sampler": "default"
+                }
+            }
+        })";
+
+        // The wall mesh is about 800 units long, so it is scaled to the size of a cell
+        constexpr float WALL_MESH_LENGTH = 808.0f;
+
+        // Returns a tint for the material of the given index (the materials only differ by their tint)
+        glm::vec3 materialTint(int index, int count) {
+            if(count <= 1) return glm::vec3(1.0f);
+            float hue = (float)index / count;
+            glm::vec3 color = glm::clamp(glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(0.0f, 2.0f / 3.0f, 1.0f / 3.0f)) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f);
+            return glm::mix(glm::vec3(1.0f), color, 0.5f);
+        }
+
+        nlohmann::json toJson(glm::vec3 vector) {
+            return {vector.x, vector.y, vector.z};
+        }
+
+    }
+
+    void StressSceneGenerator::configure(const nlohmann::json& config) {
+        if(!config.is_object()) return;
+        seed = config.value("seed", seed);
+        size = glm::max(config.value("size", size), glm::ivec2(1));
+        cellSize = config.value("cellSize", cellSize);
+        walls = config.value("walls", walls);
+        scarecrows = std::max(config.value("scarecrows", scarecrows), 0);
+        lights = std::max(config.value("lights", lights), 0);
+        materials = std::max(config.value("materials", materials), 1);
+        transparency = glm::clamp(config.value("transparency", transparency), 0.0f, 1.0f);
+    }
+
+    nlohmann::json StressSceneGenerator::generate() const {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // Every cell starts closed, then the search removes the walls between the cells it walks through
+        // The walls along x are stored by row ((size.y + 1) rows of size.x) and the walls along z by column
+        std::vector<bool> xWalls((size.y + 1) * size.x, true), zWalls(size.y * (size.x + 1), true);
+        std::vector<bool> visited(size.x * size.y, false);
+        std::vector<glm::ivec2> stack = {glm::ivec2(0, 0)};
+        visited[0] = true;
+        while(!stack.empty()) {
+            glm::ivec2 cell = stack.back();
+            glm::ivec2 neighbors[4];
+            int count = 0;
+            const glm::ivec2 directions[] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+            for(glm::ivec2 direction : directions) {
+                glm::ivec2 neighbor = cell + direction;
+                if(neighbor.x < 0 || neighbor.y < 0 || neighbor.x >= size.x || neighbor.y >= size.y) continue;
+                if(!visited[neighbor.y * size.x + neighbor.x]) neighbors[count++] = neighbor;
+            }
+            if(count == 0) {
+                stack.pop_back();
+                continue;
+            }
+            glm::ivec2 next = neighbors[random() % count];
+            if(next.x != cell.x) zWalls[cell.y * (size.x + 1) + std::max(cell.x, next.x)] = false;
+            else xWalls[std::max(cell.y, next.y) * size.x + cell.x] = false;
+            visited[next.y * size.x + next.x] = true;
+            stack.push_back(next);
+        }
+
+        // The world positions of the remaining walls (false for the walls along x, true for the walls along z)
+        std::vector<std::pair<glm::vec3, bool>> placed;
+        glm::vec2 origin = -getExtent() * 0.5f;
+        for(int row = 0; row <= size.y; row++)
+            for(int column = 0; column < size.x; column++)
+                if(xWalls[row * size.x + column])
+                    placed.push_back({glm::vec3(origin.x + (column + 0.5f) * cellSize, 0.0f, origin.y + row * cellSize), false});
+        for(int row = 0; row < size.y; row++)
+            for(int column = 0; column <= size.x; column++)
+                if(zWalls[row * (size.x + 1) + column])
+                    placed.push_back({glm::vec3(origin.x + column * cellSize, 0.0f, origin.y + (row + 0.5f) * cellSize), true});
+        if(walls >= 0 && walls < (int)placed.size()) {
+            std::shuffle(placed.begin(), placed.end(), random);
+            placed.resize(walls);
+        }
+
+        nlohmann::json assets = nlohmann::json::parse(SHARED_ASSETS);
+        for(int index = 0; index < materials; index++) {
+            glm::vec3 tint = materialTint(index, materials);
+            assets["materials"]["wall-" + std::to_string(index)] = {
+                {"type", "lighted"}, {"shader", "lighted"}, {"instancedShader", "lighted-instanced"},
+                {"pipelineState", {{"faceCulling", {{"enabled", true}}}, {"depthTesting", {{"enabled", true}}}}},
+                {"tint", {tint.r, tint.g, tint.b, 1.0f}}, {"sampler", "default"},
+                {"albedo", "wall"}, {"roughness", "roughness"}, {"specular", "white"}, {"ambient_occlusion", "black"}
+            };
+            assets["materials"]["glass-" + std::to_string(index)] = {
+                {"type", "textured"}, {"shader", "textured"},
+                {"pipelineState", {
+                    {"faceCulling", {{"enabled", false}}}, {"depthTesting", {{"enabled", true}}},
+                    {"blending", {{"enabled", true}, {"sourceFactor", "GL_SRC_ALPHA"}, {"destinationFactor", "GL_ONE_MINUS_SRC_ALPHA"}}},
+                    {"depthMask", false}
+                }},
+                {"transparent", true}, {"tint", {tint.r, tint.g, tint.b, 0.6f}}, {"texture", "glass"}, {"sampler", "pixelated"}
+            };
+        }
+
+        nlohmann::json world = nlohmann::json::array();
+        world.push_back({{"name", "camera"}, {"position", {0.0f, 0.2f, 0.0f}}, {"components", {{{"type", "Camera"}}}}});
+        glm::vec2 extent = getExtent();
+        world.push_back({
+            {"name", "floor"},
+            {"position", {0.0f, 0.0f, 0.0f}},
+            {"rotation", {-90.0f, 0.0f, 0.0f}},
+            {"scale", {extent.x * 0.5f, extent.y * 0.5f, 1.0f}},
+            {"components", {{{"type", "Mesh Renderer"}, {"mesh", "plane"}, {"material", "floor"}, {"static", true}}}}
+        });
+
+        float wallScale = cellSize / WALL_MESH_LENGTH;
+        for(auto& [position, alongZ] : placed) {
+            int material = random() % materials;
+            bool transparent = unit(random) < transparency;
+            world.push_back({
+                {"position", toJson(position)},
+                {"rotation", {0.0f, alongZ ? 90.0f : 0.0f, 0.0f}},
+                {"scale", {wallScale, wallScale, wallScale}},
+                {"components", {
+                    // The transparent walls are sorted every frame, so they can't be merged into the static batches
+                    {{"type", "Mesh Renderer"}, {"mesh", "wall"},
+                     {"material", (transparent ? "glass-" : "wall-") + std::to_string(material)}, {"static", !transparent}},
+                    {{"type", alongZ ? "zwall" : "wall"}}
+                }}
+            });
+        }
+
+        // The scarecrows and the lights are put at the centers of random cells
+        std::uniform_int_distribution<int> column(0, size.x - 1), row(0, size.y - 1);
+        auto randomCell = [&]() {
+            return glm::vec3(origin.x + (column(random) + 0.5f) * cellSize, 0.0f, origin.y + (row(random) + 0.5f) * cellSize);
+        };
+        for(int index = 0; index < scarecrows; index++) {
+            glm::vec3 velocity = glm::vec3(random() % 2 ? 0.4f : -0.4f, 0.0f, random() % 2 ? 0.4f : -0.4f);
+            world.push_back({
+                {"position", toJson(randomCell() + glm::vec3(0.0f, -0.2f, 0.0f))},
+                {"scale", {0.04f, 0.04f, 0.04f}},
+                {"components", {
+                    {{"type", "Mesh Renderer"}, {"mesh", "scarecrow"}, {"material", "scarecrow"}},
+                    {{"type", "scarecrow"}},
+                    {{"type", "Scare Crow Controller"}},
+                    {{"type", "Movement"}, {"linearVelocity", toJson(velocity)}, {"angularVelocity", {0, 0, 0}}}
+                }}
+            });
+        }
+        for(int index = 0; index < lights; index++) {
+            glm::vec3 color = materialTint(index, std::max(lights, 2)) * 0.7f;
+            world.push_back({
+                {"position", toJson(randomCell() + glm::vec3(0.0f, 0.4f, 0.0f))},
+                {"components", {{
+                    {"type", "light"}, {"typeOfLight", "POINT"},
+                    {"diffuse", toJson(color)}, {"specular", toJson(color)}, {"attenuation", {4.0f, 1.0f, 1.0f}}
+                }}}
+            });
+        }
+
+        return {{"assets", assets}, {"world", world}};
+    }
+
+}
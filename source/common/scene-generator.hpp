@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+
+namespace our {
+
+    // Generates maze scenes of any size for stressing the renderer and the ECS (the only hand-written scene is
+    // "config/app.jsonc"). The scene is returned in the format of the "scene" object of the app config (its "assets"
+    // and "world"), so it can be loaded like any other scene or saved and edited by hand.
+    // The maze is a grid of cells carved by a randomized depth first search (so every cell can be reached), and
+    // its walls use the same mesh and components ("wall" along x and "zwall" along z) as the maze of the game.
+    // The same settings and seed always give the same scene, so the benchmarks can compare runs.
+    class StressSceneGenerator {
+        uint32_t seed = 1;
+        // The number of cells along x and z, and the size of a cell (the length of a wall)
+        glm::ivec2 size = glm::ivec2(16, 16);
+        float cellSize = 0.8f;
+        // The number of walls to keep (randomly picked from the walls of the maze), -1 keeps all of them
+        int walls = -1;
+        int scarecrows = 16;
+        int lights = 8;
+        // The number of different materials given to the walls (every material breaks the batches and the instancing),
+        // and the fraction of the walls that are transparent (these are sorted every frame and never batched)
+        int materials = 1;
+        float transparency = 0.0f;
+
+    public:
+        // Reads the settings from the "generator" object of the scene config:
+        // "seed", "size" ([x, z] in cells), "cellSize", "walls", "scarecrows", "lights", "materials" and "transparency"
+        void configure(const nlohmann::json& config);
+
+        // Returns a scene object with the "assets" and the "world" of the generated maze
+        // The world starts with a camera at the center of the maze
+        nlohmann::json generate() const;
+
+        // The size of the maze along x and z in world units (the maze is centered at the origin)
+        glm::vec2 getExtent() const { return glm::vec2(size) * cellSize; }
+    };
+
+}
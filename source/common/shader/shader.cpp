@@ -3,6 +3,8 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
@@ -16,8 +18,12 @@ bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const
         return false;
     }
     std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
     file.close();
+    return attachSource(sourceString, type);
+}
+
+bool our::ShaderProgram::attachSource(const std::string &source, GLenum type) const {
+    const char* sourceCStr = source.c_str();
 
     //TODO: Complete this function
     //Note: The function "checkForShaderCompilationErrors" checks if there is
@@ -41,7 +47,7 @@ bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const
 
 
 
-bool our::ShaderProgram::link() const {
+bool our::ShaderProgram::link() {
     //TODO: Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
     // an error in the given program. You should use it to check if there is a
@@ -54,9 +60,82 @@ bool our::ShaderProgram::link() const {
         std::cout << s;
         return false; 
     }
+    // Now that the uniforms have locations, we read them all once so that "set" never has to ask OpenGL
+    introspectUniforms();
+    // Connect the engine uniform blocks (if the shader uses them) to their binding points
+    bindUniformBlock(FRAME_BLOCK_NAME, FRAME_BLOCK_BINDING);
+    bindUniformBlock(LIGHTS_BLOCK_NAME, LIGHTS_BLOCK_BINDING);
+    bindUniformBlock(CLUSTERS_BLOCK_NAME, CLUSTERS_BLOCK_BINDING);
+    // Connect the engine samplers (if the shader uses them) to their texture units
+    bindSamplerUnit(LIGHT_DATA_SAMPLER_NAME, LIGHT_DATA_TEXTURE_UNIT);
+    bindSamplerUnit(CLUSTER_DATA_SAMPLER_NAME, CLUSTER_DATA_TEXTURE_UNIT);
+    bindSamplerUnit(LIGHT_INDICES_SAMPLER_NAME, LIGHT_INDICES_TEXTURE_UNIT);
+    return true;
+}
+
+bool our::ShaderProgram::bindSamplerUnit(const char* samplerName, GLuint unit) {
+    GLint location = getUniformLocation(samplerName);
+    if(location < 0) return false;
+    // Samplers keep their value in the program, so setting them once after linking is enough
+    use();
+    glUniform1i(location, (GLint)unit);
+    return true;
+}
+
+bool our::ShaderProgram::bindUniformBlock(const char* blockName, GLuint binding) const {
+    GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+    if(blockIndex == GL_INVALID_INDEX) return false;
+    glUniformBlockBinding(program, blockIndex, binding);
     return true;
 }
 
+void our::ShaderProgram::cacheUniformLocation(std::string name, GLint location) {
+    uniformNames.push_back(std::move(name));
+    uniformLocations[uniformNames.back()] = location;
+}
+
+void our::ShaderProgram::introspectUniforms() {
+    uniformLocations.clear();
+    uniformNames.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(std::max(maxLength, 1));
+    for(GLint index = 0; index < count; index++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)index, maxLength, &length, &size, &type, buffer.data());
+        std::string name(buffer.data(), length);
+        GLint location = glGetUniformLocation(program, name.c_str());
+        // Uniforms inside uniform blocks don't have locations
+        if(location < 0) continue;
+        // Arrays of basic types are reported once as "name[0]" so we also add "name" and the rest of the elements
+        // (Arrays of structs are reported member by member, e.g. "lights[3].position", so they need nothing special)
+        if(size > 1 || (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)) {
+            std::string base = name.substr(0, name.rfind('['));
+            for(GLint element = 1; element < size; element++) {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                cacheUniformLocation(elementName, glGetUniformLocation(program, elementName.c_str()));
+            }
+            cacheUniformLocation(base + "[0]", location);
+            cacheUniformLocation(base, location);
+        } else {
+            cacheUniformLocation(name, location);
+        }
+    }
+}
+
+GLint our::ShaderProgram::queryUniformLocation(std::string_view name) {
+    // The name is not an active uniform (it could be misspelled or optimized out by the compiler)
+    // We still ask OpenGL once then remember the answer (usually -1) so the next lookup doesn't reach the driver
+    std::string nameString(name);
+    GLint location = glGetUniformLocation(program, nameString.c_str());
+    cacheUniformLocation(std::move(nameString), location);
+    return location;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
@@ -2,19 +2,56 @@
 #define SHADER_HPP
 
 #include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "../gl-state-cache.hpp"
+#include "uniform-blocks.hpp"
+
 namespace our {
 
+    // A pre-resolved uniform location which callers can keep to skip looking the uniform up by name on every "set"
+    // The type parameter is the type of the values the uniform accepts, so sending a value of the wrong type is caught at compile time
+    template<typename T>
+    struct UniformHandle {
+        using ValueType = T;
+        GLint location = -1; // -1 means the uniform doesn't exist (or was optimized out) so setting it does nothing
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
 
+        // The locations of the uniforms by their names. It is filled with the active uniforms after linking,
+        // then any other name that gets requested is added the first time it is queried.
+        // The keys view the strings stored in "uniformNames" (a deque never moves its elements on push_back)
+        // so looking up a string literal or a std::string doesn't allocate a new string.
+        std::unordered_map<std::string_view, GLint> uniformLocations;
+        std::deque<std::string> uniformNames;
+
+        // Adds a name to the uniform location table
+        void cacheUniformLocation(std::string name, GLint location);
+        // Reads all the active uniforms of the linked program into the uniform location table
+        void introspectUniforms();
+        // Called on a table miss. It asks OpenGL for the location then remembers it.
+        GLint queryUniformLocation(std::string_view name);
+
+        // These functions send a value to the uniform at the given location
+        static void upload(GLint location, GLfloat value) { glUniform1f(location, value); }
+        static void upload(GLint location, GLuint value) { glUniform1ui(location, value); }
+        static void upload(GLint location, GLint value) { glUniform1i(location, value); }
+        static void upload(GLint location, glm::vec2 value) { glUniform2f(location, value.x, value.y); }
+        static void upload(GLint location, glm::vec3 value) { glUniform3f(location, value.x, value.y, value.z); }
+        static void upload(GLint location, glm::vec4 value) { glUniform4f(location, value.x, value.y, value.z, value.w); }
+        static void upload(GLint location, const glm::mat4& matrix) { glUniformMatrix4fv(location, 1, false, &matrix[0][0]); }
+
     public:
         ShaderProgram(){
             //TODO: (Req 1) Create A shader program
@@ -23,54 +60,84 @@ namespace our {
         ~ShaderProgram(){
             //TODO: (Req 1) Delete a shader program
             glDeleteProgram(program);
+            GLStateCache::forgetProgram(program);
         }
 
         bool attach(const std::string &filename, GLenum type) const;
+        // Same as "attach" but the GLSL code is given directly (e.g. when it is generated by the engine)
+        bool attachSource(const std::string &source, GLenum type) const;
+
+        bool link();
 
-        bool link() const;
+        // Connects the uniform block with the given name to the given binding point
+        // Returns false if the program has no active block with that name
+        bool bindUniformBlock(const char* blockName, GLuint binding) const;
+        // Sets the sampler with the given name to read from the given texture unit
+        // Returns false if the program has no active uniform with that name
+        bool bindSamplerUnit(const char* samplerName, GLuint unit);
 
         void use() { 
-            glUseProgram(program);
+            GLStateCache::useProgram(program);
         }
 
-        GLuint getUniformLocation(const std::string &name) {
+        GLint getUniformLocation(std::string_view name) {
             //TODO: (Req 1) Return the location of the uniform with the given name
-           return glGetUniformLocation(program, &name[0]);
+            // We look it up in the table built after linking instead of asking OpenGL every time
+            if(auto it = uniformLocations.find(name); it != uniformLocations.end()) return it->second;
+            return queryUniformLocation(name);
+        }
+
+        // Returns a handle that can be cached and passed to "set" instead of the uniform name
+        // The handle stays valid as long as the program is not linked again
+        template<typename T>
+        UniformHandle<T> getUniform(std::string_view name) {
+            return UniformHandle<T>{getUniformLocation(name)};
+        }
+
+        // Sends the given value to the uniform of the given handle (no lookup is done)
+        template<typename T>
+        void set(UniformHandle<T> uniform, const typename UniformHandle<T>::ValueType& value) {
+            upload(uniform.location, value);
+        }
+
+        // Sends "count" values to the elements of the uniform array whose first element has the given handle
+        void set(UniformHandle<GLint> uniform, const GLint* values, GLsizei count) {
+            glUniform1iv(uniform.location, count, values);
         }
 
-        void set(const std::string &uniform, GLfloat value) {
+        void set(std::string_view uniform, GLfloat value) {
             //TODO: (Req 1) Send the given float value to the given uniform
-            glUniform1f(getUniformLocation(uniform), value);
+            upload(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, GLuint value) {
+        void set(std::string_view uniform, GLuint value) {
             //TODO: (Req 1) Send the given unsigned integer value to the given uniform
-            glUniform1ui(getUniformLocation(uniform), value);
+            upload(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, GLint value) {
+        void set(std::string_view uniform, GLint value) {
             //TODO: (Req 1) Send the given integer value to the given uniform
-            glUniform1i(getUniformLocation(uniform), value);
+            upload(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, glm::vec2 value) {
+        void set(std::string_view uniform, glm::vec2 value) {
             //TODO: (Req 1) Send the given 2D vector value to the given uniform
-            glUniform2f(getUniformLocation(uniform), value.x, value.y);
+            upload(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, glm::vec3 value) {
+        void set(std::string_view uniform, glm::vec3 value) {
             //TODO: (Req 1) Send the given 3D vector value to the given uniform
-            glUniform3f(getUniformLocation(uniform), value.x, value.y, value.z);
+            upload(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, glm::vec4 value) {
+        void set(std::string_view uniform, glm::vec4 value) {
             //TODO: (Req 1) Send the given 4D vector value to the given uniform
-            glUniform4f(getUniformLocation(uniform), value.x, value.y, value.z, value.w);       //What is the fourth element named?
+            upload(getUniformLocation(uniform), value);       //What is the fourth element named?
         }
 
-        void set(const std::string &uniform, glm::mat4 matrix) {
+        void set(std::string_view uniform, const glm::mat4& matrix) {
             //TODO: (Req 1) Send the given matrix 4x4 value to the given uniform
-            glUniformMatrix4fv(getUniformLocation(uniform), 1, false, &matrix[0][0]);
+            upload(getUniformLocation(uniform), matrix);
         }
 
         //TODO: (Req 1) Delete the copy constructor and assignment operator.
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+namespace our {
+
+    // Uniform blocks let us upload data shared by many shaders (camera and lights) once per frame into a buffer,
+    // instead of sending it to every shader (and for every draw) using glUniform*.
+    // Each block declared in the shaders is connected to a fixed binding point when the program is linked
+    // (see "ShaderProgram::link"), then the renderer binds its buffers to the same binding points.
+    // The structs below mirror the "std140" layout of the blocks in the shaders, so the padding members must stay
+    // where they are. If you change a block in the shaders, change its struct here too (and vice versa).
+
+    // The binding points of the engine blocks
+    constexpr GLuint FRAME_BLOCK_BINDING = 0;
+    constexpr GLuint LIGHTS_BLOCK_BINDING = 1;
+    constexpr GLuint CLUSTERS_BLOCK_BINDING = 2;
+
+    // The names of the blocks in the shaders
+    constexpr const char* FRAME_BLOCK_NAME = "Frame";
+    constexpr const char* LIGHTS_BLOCK_NAME = "Lights";
+    constexpr const char* CLUSTERS_BLOCK_NAME = "Clusters";
+
+    // The clustered lighting data is too big for uniform blocks so it is read from buffer textures
+    // These are bound to the last texture units (the materials use the first ones) and the samplers of
+    // these names are connected to these units when the program is linked
+    constexpr GLuint LIGHT_DATA_TEXTURE_UNIT = 13;
+    constexpr GLuint CLUSTER_DATA_TEXTURE_UNIT = 14;
+    constexpr GLuint LIGHT_INDICES_TEXTURE_UNIT = 15;
+    constexpr const char* LIGHT_DATA_SAMPLER_NAME = "light_data";
+    constexpr const char* CLUSTER_DATA_SAMPLER_NAME = "cluster_data";
+    constexpr const char* LIGHT_INDICES_SAMPLER_NAME = "light_indices";
+
+    // Must match MAX_LIGHTS in "lighted.frag"
+    constexpr int MAX_LIGHTS = 64;
+    // The number of lights each object can pick from the Lights block (must match MAX_OBJECT_LIGHTS in "lighted.frag")
+    constexpr int MAX_OBJECT_LIGHTS = 8;
+
+    // layout(std140) uniform Frame { mat4 VP; vec3 eye; };
+    struct FrameBlock {
+        glm::mat4 VP;       // View-projection matrix
+        glm::vec3 eye;      // Camera position
+        float padding0;
+    };
+    static_assert(sizeof(FrameBlock) == 80, "FrameBlock must match the std140 layout of the Frame block");
+
+    // Mirrors the "Light" struct in "lighted.frag"
+    // In std140, every vec3 is aligned to 16 bytes and the struct size is rounded up to 16 bytes
+    struct LightData {
+        GLint type;             // Type of light (DIRECTIONAL, POINT, or SPOT)
+        GLint padding0[3];
+        glm::vec3 position;     // World position of the light
+        float padding1;
+        glm::vec3 direction;    // World direction of the light
+        float padding2;
+        glm::vec3 diffuse;      // Diffuse color of the light
+        float padding3;
+        glm::vec3 specular;     // Specular color of the light
+        float padding4;
+        glm::vec3 attenuation;  // Attenuation parameters (x*d^2 + y*d + z)
+        float padding5;
+        glm::vec2 coneAngles;   // Cone angles (x: inner angle, y: outer angle) for spotlights
+        float padding6[2];
+    };
+    static_assert(sizeof(LightData) == 112, "LightData must match the std140 layout of the Light struct");
+
+    // layout(std140) uniform Lights { Light lights[MAX_LIGHTS]; int light_count; };
+    struct LightsBlock {
+        LightData lights[MAX_LIGHTS];
+        GLint lightCount;
+        GLint padding0[3];
+    };
+    static_assert(sizeof(LightsBlock) == MAX_LIGHTS * 112 + 16, "LightsBlock must match the std140 layout of the Lights block");
+
+    // layout(std140) uniform Clusters { vec4 camera_forward; vec4 cluster_depth; vec4 cluster_viewport; uvec4 cluster_grid; int clustered_lighting; };
+    struct ClustersBlock {
+        glm::vec4 cameraForward;    // xyz: The forward direction of the camera (used to compute the fragment depth)
+        glm::vec4 depth;            // x: near, y: far, z: scale and w: bias to get the slice from log(depth)
+        glm::vec4 viewport;         // xy: origin and zw: size of the viewport in pixels
+        glm::uvec4 grid;            // xyz: The number of clusters on each axis, w: The number of global lights
+        GLint enabled;              // 0 means the lights are read from the Lights block instead
+        GLint padding0[3];
+    };
+    static_assert(sizeof(ClustersBlock) == 80, "ClustersBlock must match the std140 layout of the Clusters block");
+
+}
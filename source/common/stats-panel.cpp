@@ -0,0 +1,127 @@
+#include "stats-panel.hpp"
+#include "frame-stats.hpp"
+#include "asset-loader.hpp"
+#include "ecs/world.hpp"
+#include "shader/shader.hpp"
+#include "texture/texture2d.hpp"
+#include "texture/sampler.hpp"
+#include "mesh/mesh.hpp"
+#include "material/material.hpp"
+
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+
+namespace our {
+
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        FrameCounters lastCounters;
+        Clock::time_point frameStart;
+        bool started = false;
+
+        // The rings of the graphs, "next" is the oldest value (ImGui starts drawing from it)
+        float frameTimes[StatsPanel::HISTORY_SIZE] = {};
+        float drawCalls[StatsPanel::HISTORY_SIZE] = {};
+        int next = 0, filled = 0;
+
+        // The memory of the assets is asked from OpenGL, so it is only measured again when the number of assets changes
+        size_t measuredTextures = ~size_t(0), measuredMeshes = ~size_t(0);
+        size_t textureMemory = 0, meshMemory = 0;
+
+        void measureAssets() {
+            const auto& textures = AssetLoader<Texture2D>::getAll();
+            const auto& meshes = AssetLoader<Mesh>::getAll();
+            if(textures.size() != measuredTextures) {
+                measuredTextures = textures.size();
+                textureMemory = 0;
+                for(auto& [name, texture] : textures) if(texture) textureMemory += texture->getMemorySize();
+            }
+            if(meshes.size() != measuredMeshes) {
+                measuredMeshes = meshes.size();
+                meshMemory = 0;
+                for(auto& [name, mesh] : meshes) if(mesh) meshMemory += mesh->getMemorySize();
+            }
+        }
+
+        float toMegabytes(size_t bytes) {
+            return bytes / (1024.0f * 1024.0f);
+        }
+
+        void counterRow(const char* name, unsigned long long value) {
+            ImGui::Text("%-20s %10llu", name, value);
+        }
+    }
+
+    void StatsPanel::beginFrame() {
+        Clock::time_point now = Clock::now();
+        if(started) {
+            lastCounters = FrameStats::get();
+            frameTimes[next] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+            drawCalls[next] = (float)lastCounters.drawCalls;
+            next = (next + 1) % HISTORY_SIZE;
+            filled = std::min(filled + 1, (int)HISTORY_SIZE);
+        }
+        frameStart = now;
+        started = true;
+    }
+
+    void StatsPanel::drawPanel(bool* open) {
+        ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 360, 10), ImGuiCond_FirstUseEver);
+        if(!ImGui::Begin("Engine Stats", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+            ImGui::End();
+            return;
+        }
+
+        // The graphs of the last frames
+        float lastTime = frameTimes[(next + HISTORY_SIZE - 1) % HISTORY_SIZE];
+        float averageTime = 0.0f, maxTime = 0.0f, maxDraws = 0.0f;
+        for(int index = 0; index < HISTORY_SIZE; index++) {
+            averageTime += frameTimes[index];
+            maxTime = std::max(maxTime, frameTimes[index]);
+            maxDraws = std::max(maxDraws, drawCalls[index]);
+        }
+        // The ring is zero until it is filled, so the zeros don't change the sum
+        if(filled > 0) averageTime /= filled;
+        ImGui::Text("Frame: %.2f ms (average %.2f, max %.2f)", lastTime, averageTime, maxTime);
+        ImGui::PlotLines("##frame-times", frameTimes, HISTORY_SIZE, next, "Frame time (ms)", 0.0f, maxTime * 1.2f, ImVec2(340, 60));
+        ImGui::PlotLines("##draw-calls", drawCalls, HISTORY_SIZE, next, "Draw calls", 0.0f, maxDraws * 1.2f, ImVec2(340, 40));
+
+        // The counters of the last frame (the default font is monospaced, so the fields are aligned by their widths)
+        ImGui::Separator();
+        const FrameCounters& counters = lastCounters;
+        counterRow("Draw calls", counters.drawCalls);
+        counterRow("Triangles", counters.triangles);
+        counterRow("Material setups", counters.materialSetups);
+        counterRow("State changes", counters.stateChanges);
+        counterRow("Program binds", counters.programBinds);
+        counterRow("Texture binds", counters.textureBinds);
+        counterRow("Vertex array binds", counters.vertexArrayBinds);
+        counterRow("Allocations", counters.allocations);
+        uint64_t commands = counters.visibleCommands + counters.culledCommands;
+        ImGui::Text("%-20s %10llu (%.0f%% culled)", "Visible commands", (unsigned long long)counters.visibleCommands,
+                    commands ? 100.0 * counters.culledCommands / commands : 0.0);
+        counterRow("Culled commands", counters.culledCommands);
+
+        // The components are counted by walking the world, so it is only done while the section is open
+        ImGui::Separator();
+        World* world = FrameStats::getWorld();
+        counterRow("Entities", world ? world->getEntities().size() : 0);
+        if(world && ImGui::TreeNode("Components by type")) {
+            for(auto& [type, count] : world->countComponents())
+                counterRow(type.c_str(), count);
+            ImGui::TreePop();
+        }
+
+        ImGui::Separator();
+        measureAssets();
+        counterRow("Shaders", AssetLoader<ShaderProgram>::getAll().size());
+        ImGui::Text("%-20s %10zu (%.2f MB)", "Textures", measuredTextures, toMegabytes(textureMemory));
+        counterRow("Samplers", AssetLoader<Sampler>::getAll().size());
+        ImGui::Text("%-20s %10zu (%.2f MB)", "Meshes", measuredMeshes, toMegabytes(meshMemory));
+        counterRow("Materials", AssetLoader<Material>::getAll().size());
+        ImGui::End();
+    }
+
+}
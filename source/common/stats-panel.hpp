@@ -0,0 +1,22 @@
+#pragma once
+
+namespace our {
+
+    // Shows the statistics of the engine in an ImGui window: the counters of the last frame (see "frame-stats.hpp"),
+    // the components of the drawn world by type, the loaded assets with their memory, and graphs of the last frames.
+    // The counters of the frame being drawn are not complete while the GUI is built, so the panel shows the last frame.
+    class StatsPanel {
+    public:
+        // The number of frames shown in the graphs
+        static constexpr int HISTORY_SIZE = 240;
+
+        // Called by the application at the start of every frame before the frame stats are reset.
+        // It keeps the counters and the time of the last frame.
+        static void beginFrame();
+
+        // Draws the panel (this must be called between ImGui::NewFrame and ImGui::Render)
+        // "open" is set to false if the user closes the window
+        static void drawPanel(bool* open = nullptr);
+    };
+
+}
@@ -0,0 +1,116 @@
+#include "stream-buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace our {
+
+    // The buffer is only ever bound to GL_COPY_WRITE_BUFFER here, so we don't change the bindings the renderer relies on
+    static constexpr GLenum STREAM_TARGET = GL_COPY_WRITE_BUFFER;
+
+    void StreamBuffer::initialize(GLsizeiptr frameSize, bool allowPersistent) {
+        destroy();
+        this->frameSize = frameSize;
+        persistent = allowPersistent && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage);
+        createStorage();
+    }
+
+    void StreamBuffer::destroy() {
+        deleteStorage(true);
+        if(!retired.empty()) glDeleteBuffers((GLsizei)retired.size(), retired.data());
+        retired.clear();
+    }
+
+    void StreamBuffer::createStorage() {
+        capacity = frameSize * FRAMES_IN_FLIGHT;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(STREAM_TARGET, buffer);
+        if(persistent) {
+            // Coherent mapping makes our writes visible to the commands sent after them without flushing
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(STREAM_TARGET, capacity, nullptr, flags);
+            mapped = (GLubyte*)glMapBufferRange(STREAM_TARGET, 0, capacity, flags);
+        } else {
+            glBufferData(STREAM_TARGET, capacity, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(STREAM_TARGET, 0);
+        region = 0;
+        cursor = 0;
+        limit = persistent ? frameSize : capacity;
+    }
+
+    void StreamBuffer::deleteStorage(bool immediately) {
+        for(auto& fence : fences) {
+            if(fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        // Deleting a mapped buffer unmaps it, and OpenGL keeps the storage alive till the GPU is done with it
+        if(buffer) {
+            if(immediately) glDeleteBuffers(1, &buffer);
+            else retired.push_back(buffer);
+        }
+        buffer = 0;
+        mapped = nullptr;
+        blockMapped = false;
+    }
+
+    void StreamBuffer::beginFrame() {
+        // The previous frame is done sending commands, so the buffers it replaced are not needed anymore
+        if(!retired.empty()) glDeleteBuffers((GLsizei)retired.size(), retired.data());
+        retired.clear();
+        // In the fallback mode, the blocks just keep going around the buffer (orphaning it when it is full)
+        if(!persistent || !buffer) return;
+        // Every command reading the current region was sent by now, so its fence is signaled when they are done
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % FRAMES_IN_FLIGHT;
+        cursor = region * frameSize;
+        limit = cursor + frameSize;
+        // The new region was used FRAMES_IN_FLIGHT frames ago, so this rarely waits
+        if(GLsync fence = fences[region]; fence) {
+            while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(fence);
+            fences[region] = nullptr;
+        }
+    }
+
+    void* StreamBuffer::map(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset) {
+        offset = (cursor + alignment - 1) / alignment * alignment;
+        if(offset + size > limit) {
+            if(persistent || size > capacity) {
+                // The frame needs more than we have, so we replace the buffer by a larger one
+                frameSize = std::max(frameSize * 2, size + alignment);
+                deleteStorage(false);
+                createStorage();
+            } else {
+                // Orphan the storage: the driver keeps the old memory for the GPU and gives us new memory
+                glBindBuffer(STREAM_TARGET, buffer);
+                glBufferData(STREAM_TARGET, capacity, nullptr, GL_STREAM_DRAW);
+                glBindBuffer(STREAM_TARGET, 0);
+                cursor = 0;
+            }
+            offset = (cursor + alignment - 1) / alignment * alignment;
+        }
+        cursor = offset + size;
+        if(persistent) return mapped + offset;
+        // Nothing was written to this part of the storage since it was created, so there is no need to synchronize
+        glBindBuffer(STREAM_TARGET, buffer);
+        blockMapped = true;
+        return glMapBufferRange(STREAM_TARGET, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    void StreamBuffer::unmap() {
+        if(!blockMapped) return;
+        glBindBuffer(STREAM_TARGET, buffer);
+        glUnmapBuffer(STREAM_TARGET);
+        glBindBuffer(STREAM_TARGET, 0);
+        blockMapped = false;
+    }
+
+    GLintptr StreamBuffer::upload(const void* data, GLsizeiptr size, GLsizeiptr alignment) {
+        GLintptr offset;
+        std::memcpy(map(size, alignment, offset), data, size);
+        unmap();
+        return offset;
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <vector>
+
+namespace our {
+
+    // A buffer that the CPU fills with new data every frame (e.g. the instance matrices and the uniform blocks)
+    // Calling glBufferData/glBufferSubData every time makes the driver either wait for the GPU to finish reading the
+    // old data or copy it somewhere else. Instead, the data of the frame is written after the data of the previous
+    // frames (like a ring), so the CPU never writes over the data that the GPU may still be reading.
+    // Any number of blocks can be allocated from it every frame, each one is then used through its offset in the buffer.
+    //
+    // If the driver supports ARB_buffer_storage (core in OpenGL 4.4), the buffer is mapped once and stays mapped
+    // (persistent mapping). It is split into FRAMES_IN_FLIGHT regions, one for each frame, and a fence is placed after
+    // the commands of every frame. Before reusing a region, we wait for its fence (which is normally long done).
+    // Otherwise (plain OpenGL 3.3), every block is mapped unsynchronized after the previous one, and when the buffer is
+    // full, its storage is orphaned (glBufferData with nullptr) so the driver gives us fresh memory without waiting.
+    class StreamBuffer {
+    public:
+        static constexpr int FRAMES_IN_FLIGHT = 3;
+
+    private:
+        GLuint buffer = 0;
+        bool persistent = false;
+        GLsizeiptr frameSize = 0;       // The size of every region (in persistent mode)
+        GLsizeiptr capacity = 0;        // The size of the whole buffer
+        GLintptr cursor = 0;            // Where the next block may start
+        GLintptr limit = 0;             // Where the current region ends
+        GLubyte* mapped = nullptr;      // The persistent mapping of the whole buffer
+        GLsync fences[FRAMES_IN_FLIGHT] = {};
+        int region = 0;
+        bool blockMapped = false;       // Whether a block is mapped in the fallback mode (till "unmap" is called)
+        // The buffers replaced by larger ones during this frame. Deleting a buffer unbinds it from the context (e.g. from
+        // the uniform block bindings) while the frame may still draw with it, so they are only deleted in "beginFrame".
+        std::vector<GLuint> retired;
+
+        // Creates the storage of the buffer (of "frameSize" bytes for every frame)
+        void createStorage();
+        // Deletes the fences and retires the buffer (or deletes it right away if "immediately" is true)
+        void deleteStorage(bool immediately);
+
+    public:
+        // Creates the buffer. "frameSize" is the number of bytes expected to be allocated every frame (the buffer
+        // grows if a frame needs more). If "allowPersistent" is false, the fallback is used even if persistent mapping is supported.
+        void initialize(GLsizeiptr frameSize, bool allowPersistent = true);
+        void destroy();
+
+        // Marks the end of the previous frame and waits (if needed) for the region of the new frame to be free
+        // This should be called once per frame before allocating anything
+        void beginFrame();
+
+        // Reserves "size" bytes whose offset is a multiple of "alignment" and returns where to write them.
+        // The offset of the block in the buffer is written to "offset". "unmap" must be called after writing the data
+        // and before drawing with it. The buffer may be recreated when it grows, so "getBuffer" must be called after this.
+        void* map(GLsizeiptr size, GLsizeiptr alignment, GLintptr& offset);
+        void unmap();
+        // Copies the data into a new block and returns its offset
+        GLintptr upload(const void* data, GLsizeiptr size, GLsizeiptr alignment);
+
+        GLuint getBuffer() const { return buffer; }
+        bool isPersistent() const { return persistent; }
+    };
+
+}
@@ -0,0 +1,58 @@
+#include "dynamic-resolution.hpp"
+#include "../gpu-timers.hpp"
+#include "../cpu-profiler.hpp"
+
+#include <cmath>
+
+namespace our
+{
+
+    void DynamicResolution::configure(const nlohmann::json &config)
+    {
+        enabled = true;
+        budget = config.value("budget", budget);
+        minScale = config.value("minScale", minScale);
+        maxScale = config.value("maxScale", maxScale);
+        step = glm::max(config.value("step", step), 0.01f);
+        headroom = config.value("headroom", headroom);
+        scale = maxScale;
+        smoothedTime = 0.0;
+        cooldown = 0;
+    }
+
+    void DynamicResolution::update(double gpuMilliseconds)
+    {
+        PROFILE_SCOPE("DynamicResolution::update");
+        if (!enabled || gpuMilliseconds <= 0.0)
+            return;
+        if (cooldown > 0)
+        {
+            cooldown--;
+            return;
+        }
+        // A bit of smoothing so that a single slow frame doesn't change the scale
+        smoothedTime = smoothedTime == 0.0 ? gpuMilliseconds : glm::mix(smoothedTime, gpuMilliseconds, 0.25);
+
+        float newScale = scale;
+        if (smoothedTime > budget)
+        {
+            // Shrink straight to the scale that should fit the budget (rounded down to a step)
+            float fitting = scale * (float)std::sqrt(budget / smoothedTime);
+            newScale = std::floor(fitting / step) * step;
+        }
+        else if (smoothedTime < budget * headroom)
+        {
+            // Grow one step at a time since growing too much would go over the budget
+            newScale = scale + step;
+        }
+        newScale = glm::clamp(newScale, minScale, maxScale);
+        if (newScale != scale)
+        {
+            scale = newScale;
+            smoothedTime = 0.0;
+            // The frames already sent were drawn at the old scale
+            cooldown = GPUTimers::FRAMES_IN_FLIGHT + 1;
+        }
+    }
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+
+namespace our
+{
+
+    // Dynamic resolution scaling
+    // The 3D scene is drawn into an offscreen target whose size is the window size multiplied by a scale, then it is
+    // upsampled to the window. Every frame, the scale is adjusted from the measured GPU time of the frame so that it
+    // stays under a budget: the cost of drawing the scene grows with the number of pixels (the square of the scale),
+    // so a frame that takes too long shrinks the scale by the square root of how much it went over.
+    // The GPU times arrive a few frames late (see "gpu-timers.hpp"), so after every change we wait for the times
+    // measured at the new scale before changing it again. The scale moves in steps so the render targets
+    // (which are pooled by their size) are not recreated every frame.
+    // It is off unless the renderer config has a "dynamicResolution" object, e.g. for a game that targets 60 fps:
+    //     "dynamicResolution": {"budget": 16.6, "minScale": 0.5, "maxScale": 1.0, "step": 0.05, "headroom": 0.8}
+    // The budget should leave room for the CPU and the presentation, since only the GPU passes are measured.
+    class DynamicResolution {
+        bool enabled = false;
+        // The GPU time (in milliseconds) that the frames should stay under
+        float budget = 16.0f;
+        // The range of the scale and the size of its steps
+        float minScale = 0.5f, maxScale = 1.0f, step = 0.05f;
+        // The scale only grows when the frames take less than this fraction of the budget (so that it doesn't oscillate)
+        float headroom = 0.8f;
+        float scale = 1.0f;
+        // The smoothed GPU time of the frames
+        double smoothedTime = 0.0;
+        // The number of frames to ignore before the times measured at the current scale arrive
+        int cooldown = 0;
+
+    public:
+        // Reads the settings from the "dynamicResolution" object of the renderer config:
+        // "budget" (milliseconds), "minScale", "maxScale", "step" and "headroom"
+        void configure(const nlohmann::json& config);
+        bool isEnabled() const { return enabled; }
+
+        // Updates the scale from the GPU time of a recent frame (in milliseconds, 0 if it isn't known yet)
+        void update(double gpuMilliseconds);
+
+        float getScale() const { return enabled ? scale : 1.0f; }
+        // Returns the size of the scene target for the given window size
+        glm::ivec2 getRenderSize(glm::ivec2 windowSize) const {
+            return glm::max(glm::ivec2(glm::round(glm::vec2(windowSize) * getScale())), glm::ivec2(1));
+        }
+    };
+
+}
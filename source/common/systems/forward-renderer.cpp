@@ -1,14 +1,26 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../job-system.hpp"
+#include "../flight-recorder.hpp"
 #include "iostream"
 #include <glm/gtx/euler_angles.hpp>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 namespace our
 {
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
     {
+        PROFILE_SCOPE("ForwardRenderer::initialize");
         // First, we store the window size for later use
         this->windowSize = windowSize;
+        renderSize = windowSize;
+        // The shaders of a previous state may have been deleted (and their addresses reused), so we forget their uniforms
+        shaderUniforms.clear();
 
         // Then we check if there is a sky texture in the configuration
         if (config.contains("sky"))
@@ -52,31 +64,75 @@ namespace our
             this->skyMaterial->transparent = false;
         }
 
-        // Then we check if there is a postprocessing shader in the configuration
-        if (config.contains("postprocess"))
+        // Hardware instancing can be disabled from the configuration (e.g. for comparing the performance)
+        instancing = config.value("instancing", true);
+        // Create the stream buffer that will hold the per-instance data of instanced draws and the uniform blocks
+        // Persistent mapping can be disabled from the configuration (e.g. for testing the OpenGL 3.3 fallback)
+        streamBuffer.initialize(STREAM_FRAME_SIZE, config.value("persistentMapping", true));
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        // Clustered lighting can be disabled from the configuration (e.g. for comparing the performance)
+        clusteredLighting = config.value("clusteredLighting", true);
+        lightClusters.initialize(config);
+        // The cell size of the grid used to find the lights that affect each object (when the clusters are not used)
+        lightCuller.setCellSize(config.value("lightGridCellSize", 4.0f));
+        // The size of the chunks used to split the static batches (so that the chunks could be culled separately)
+        staticChunkSize = config.value("staticChunkSize", 8.0f);
+        // The potentially visible set is baked later (in "buildVisibility") since the world is not loaded yet
+        pvsEnabled = config.contains("pvs");
+        if (pvsEnabled)
+            pvs.configure(config["pvs"]);
+        // The occluders are picked by their mesh names, so the configuration can enable the culling without touching the scene
+        if (config.contains("occlusion"))
+            occlusion.configure(config["occlusion"]);
+        // The level of detail selection (the levels themselves are generated when the meshes are loaded)
+        lodEnabled = config.contains("lod");
+        if (lodEnabled)
         {
-            // TODO: (Req 11) Create a framebuffer
-            glGenFramebuffers(1, &postprocessFrameBuffer);
-
-            // TODO: (Req 11) Create a color and a depth texture and attach them to the framebuffer
-            //  Hints: The color format can be (Red, Green, Blue and Alpha components with 8 bits for each channel).
-            //  The depth format can be (Depth component with 24 bits).
-            colorTarget = new Texture2D();
-            colorTarget->bind();
-            int levels = (int)glm::floor(glm::log2((float)glm::max(windowSize.x, windowSize.y))) + 1;
-            glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, windowSize.x, windowSize.y);
-
-            depthTarget = new Texture2D();
-            depthTarget->bind();
-            glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, windowSize.x, windowSize.y);
-
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
+            const nlohmann::json &lod = config["lod"];
+            lodSettings.thresholds = lod.value("thresholds", lodSettings.thresholds);
+            lodSettings.hysteresis = lod.value("hysteresis", lodSettings.hysteresis);
+        }
+        // The depth pre-pass can be disabled from the configuration since it only pays off when the pixels are expensive
+        depthPrepass = config.value("depthPrepass", false);
+        if (depthPrepass)
+        {
+            depthShader = new ShaderProgram();
+            depthShader->attach("assets/shaders/depth.vert", GL_VERTEX_SHADER);
+            depthShader->attach("assets/shaders/depth.frag", GL_FRAGMENT_SHADER);
+            depthShader->link();
+            depthInstancedShader = new ShaderProgram();
+            depthInstancedShader->attach("assets/shaders/depth-instanced.vert", GL_VERTEX_SHADER);
+            depthInstancedShader->attach("assets/shaders/depth.frag", GL_FRAGMENT_SHADER);
+            depthInstancedShader->link();
+        }
+        passTimers.initialize({"Depth pre-pass", "Opaque", "Sky", "Transparent", "Postprocess", "Upsample"});
 
-            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTarget->getOpenGLName(), 0);
-            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTarget->getOpenGLName(), 0);
+        // The dynamic resolution needs its own upsample pass for the frames without postprocessing
+        if (config.contains("dynamicResolution"))
+        {
+            dynamicResolution.configure(config["dynamicResolution"]);
+            upsampleShader = new ShaderProgram();
+            upsampleShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+            upsampleShader->attach("assets/shaders/blit.frag", GL_FRAGMENT_SHADER);
+            upsampleShader->link();
+            upsampleShader->bindSamplerUnit("tex", 0);
+            // Linear filtering does the upsampling
+            upsampleSampler = new Sampler();
+            upsampleSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            upsampleSampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            upsampleSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            upsampleSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glGenVertexArrays(1, &upsampleVertexArray);
+        }
 
-            // TODO: (Req 11) Unbind the framebuffer just to be safe
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        // A chain of postprocessing effects replaces the single postprocessing shader
+        if (config.contains("postprocessChain"))
+            postprocessChain.initialize(config["postprocessChain"]);
+        // Then we check if there is a postprocessing shader in the configuration
+        else if (config.contains("postprocess"))
+        {
+            // The scene color and depth textures are transient resources of the render graph (see "render")
+            // They are only allocated while the effect is active and come from the render target pool
 
             // Create a vertex array to use for drawing the texture
             glGenVertexArrays(1, &postProcessVertexArray);
@@ -102,7 +158,7 @@ namespace our
             // Create a post processing material
             postprocessMaterial = new TexturedMaterial();
             postprocessMaterial->shader = postprocessShader;
-            postprocessMaterial->texture = colorTarget;
+            postprocessMaterial->texture = nullptr;
             postprocessMaterial->sampler = postprocessSampler;
             
             // The default options are fine but we don't need to interact with the depth buffer
@@ -113,6 +169,7 @@ namespace our
 
     void ForwardRenderer::destroy()
     {
+        shaderUniforms.clear();
         // Delete all objects related to the sky
         if (skyMaterial)
         {
@@ -122,60 +179,121 @@ namespace our
             delete skyMaterial->sampler;
             delete skyMaterial;
         }
+        streamBuffer.destroy();
+        lightClusters.destroy();
+        clearStaticBatches();
+        pvs.clear();
+        delete depthShader;
+        delete depthInstancedShader;
+        depthShader = depthInstancedShader = nullptr;
+        passTimers.destroy();
+        delete upsampleShader;
+        delete upsampleSampler;
+        upsampleShader = nullptr;
+        upsampleSampler = nullptr;
+        if (upsampleVertexArray)
+        {
+            glDeleteVertexArrays(1, &upsampleVertexArray);
+            GLStateCache::forgetVertexArray(upsampleVertexArray);
+            upsampleVertexArray = 0;
+        }
+        renderGraph.clear();
+        renderTargets.clear();
+        postprocessChain.destroy();
         // Delete all objects related to post processing
-        if(postprocessMaterial && dummy){
-            glDeleteFramebuffers(1, &postprocessFrameBuffer);
+        if(postprocessMaterial){
             glDeleteVertexArrays(1, &postProcessVertexArray);
-            delete colorTarget;
-            delete depthTarget;
+            GLStateCache::forgetVertexArray(postProcessVertexArray);
             delete postprocessMaterial->sampler;
             delete postprocessMaterial->shader;
             delete postprocessMaterial;
+            postprocessMaterial = nullptr;
         }
     }
 
-    void ForwardRenderer::render(World *world)
+    CameraComponent *ForwardRenderer::buildCommands(World *world)
     {
-        // First of all, we search for a camera and for all the mesh renderers
+        RECORD_ZONE("ForwardRenderer::buildCommands");
+        // First of all, we search for a camera
         CameraComponent *camera = nullptr;
-        opaqueCommands.clear();
-        transparentCommands.clear();
-        lightSources.clear();
         for (auto entity : world->getEntities())
         {
-            // If we hadn't found a camera yet, we look for a camera in this entity
-            if (!camera)
-                camera = entity->getComponent<CameraComponent>();
-            // If this entity has a mesh renderer component
-            if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer)
-            {
-                // We construct a command from it
-                RenderCommand command;
-                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-                command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-                command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                if (command.material->transparent)
-                {
-                    transparentCommands.push_back(command);
-                }
-                else
-                {
-                    // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
-                }
-            }
-            // if light component store it
-            if (auto lightComp = entity->getComponent<LightComponent>(); lightComp)
+            camera = entity->getComponent<CameraComponent>();
+            if (camera)
+                break;
+        }
+        // If there is no camera, we return (we cannot render without a camera)
+        if (camera == nullptr)
+            return nullptr;
+        // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
+        glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
+        // The camera position picks the cells that could be seen this frame
+        pvs.setViewpoint(camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1));
+        // A perspective camera shrinks the objects with their distance while an orthographic one doesn't
+        lodEye = camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
+        lodPerspective = camera->cameraType == CameraType::PERSPECTIVE;
+        lodScale = lodPerspective ? 1.0f / glm::tan(camera->fovY * 0.5f) : 2.0f / camera->orthoHeight;
+        // Draw the occluders into the software depth buffer so the commands below can be tested against it
+        if (occlusion.isEnabled())
+        {
+            occlusion.beginFrame(VP);
+            for (auto entity : world->getEntities())
             {
-                lightSources.push_back(lightComp);
+                auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+                if (meshRenderer && occlusion.isOccluder(meshRenderer->mesh))
+                    occlusion.addOccluder(meshRenderer->mesh, entity->getLocalToWorldMatrix());
             }
+            occlusion.rasterize();
         }
 
-        // If there is no camera, we return (we cannot render without a camera)
-        if (camera == nullptr)
-            return;
+        // Then we search for all the mesh renderers and the lights
+        // The entities are split into chunks that are processed in parallel where every chunk fills its own lists
+        extractionEntities.assign(world->getEntities().begin(), world->getEntities().end());
+        size_t chunkCount = (extractionEntities.size() + EXTRACTION_CHUNK_SIZE - 1) / EXTRACTION_CHUNK_SIZE;
+        chunkCommands.resize(chunkCount);
+        for (auto &commands : chunkCommands)
+        {
+            commands.opaque.clear();
+            commands.transparent.clear();
+            commands.lights.clear();
+            commands.culled = 0;
+        }
+        // The job system is given the chunk indices (not the entities) since it picks the sizes of the ranges it hands out
+        JobSystem::parallelFor(chunkCount, 1, [this](size_t begin, size_t end, unsigned)
+                               {
+                                   for (size_t chunk = begin; chunk < end; chunk++)
+                                   {
+                                       size_t first = chunk * EXTRACTION_CHUNK_SIZE;
+                                       size_t last = std::min(first + EXTRACTION_CHUNK_SIZE, extractionEntities.size());
+                                       extractCommands(first, last, chunkCommands[chunk]);
+                                   }
+                               });
+        // Then the lists of the chunks are merged in their order, which is the order a single thread would extract them in
+        // (the commands at the same depth keep it through the sorts, and the lights are given to the clusters in it)
+        opaqueCommands.clear();
+        transparentCommands.clear();
+        lightSources.clear();
+        size_t culledCommands = 0;
+        for (const auto &commands : chunkCommands)
+        {
+            culledCommands += commands.culled;
+            opaqueCommands.insert(opaqueCommands.end(), commands.opaque.begin(), commands.opaque.end());
+            transparentCommands.insert(transparentCommands.end(), commands.transparent.begin(), commands.transparent.end());
+            lightSources.insert(lightSources.end(), commands.lights.begin(), commands.lights.end());
+        }
+
+        // The static batches are drawn like any other opaque command
+        // (they have no component to remember their level of detail, so the stored commands remember it instead)
+        for (auto &command : staticCommands)
+            if (pvs.isVisible(command.boxMin, command.boxMax) && occlusion.isVisible(command.boxMin, command.boxMax))
+            {
+                if (lodEnabled)
+                    command.lod = lodSettings.pick(command.lod, getScreenSize(command.bounds));
+                opaqueCommands.push_back(command);
+            }
+            else
+                culledCommands++;
+        FrameStats::countCommands(opaqueCommands.size() + transparentCommands.size(), culledCommands);
 
         //TODO: (Req 9) Modify the following line such that "cameraForward" contains a vector pointing the camera forward direction
         // HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
@@ -192,87 +310,237 @@ namespace our
         glm::vec3 eye = M * glm::vec4(0, 0, 0, 1);
         glm::vec3 center = M * glm::vec4(0, 0, -1, 1);
         glm::vec3 cameraForward = glm::normalize(center - eye);
-        std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand &first, const RenderCommand &second)
-                  {
-            //TODO: (Req 9) Finish this function
-            // HINT: the following return should return true "first" should be drawn before "second". 
-            //the dot product of two vectors is a scalar (a single number). represents the magnitude of the projection of one vector onto the other. 
-            //In other words, it measures how much of one vector is pointing in the same direction as the other vector.
-            //so by these i know which object i nearer to the camera
-            if (glm::dot(cameraForward,first.center) > glm::dot(cameraForward,second.center)  )
-            return true;
-            else
-            return false; });
+        //TODO: (Req 9) Sort the transparent commands from the farthest to the nearest
+        // The sorter computes the depth of every command once (the dot product with "cameraForward") instead of in
+        // every comparison, then radix sorts them (see "transparent-sorter.hpp")
+        transparentSorter.sort(transparentCommands, eye, cameraForward);
+        return camera;
+    }
 
-        // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
+    void ForwardRenderer::render(World *world)
+    {
+        RECORD_ZONE("ForwardRenderer::render");
+        FrameStats::setWorld(world);
+        // The commands are built on the CPU first, then they are drawn
+        CameraComponent *camera = buildCommands(world);
+        if (camera == nullptr)
+            return;
         glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
-         //TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
-        //glViewport((lower left corner of the viewport rectangle),(width and height of the viewport))
-        glViewport(0, 0, windowSize.x, windowSize.y);
+        glm::vec3 eye = camera->getOwner()->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
+
+        // The stream buffer region of this frame must be free before anything is written to it
+        streamBuffer.beginFrame();
+        // The GPU times of an older frame are ready by now, so we read them before measuring this one
+        passTimers.beginFrame();
+        // Then the dynamic resolution picks the size of the scene from them
+        dynamicResolution.update(passTimers.getTotalMilliseconds());
+        renderSize = dynamicResolution.getRenderSize(windowSize);
+        bool scaled = renderSize != windowSize;
+        // The camera and the lights are the same for every draw, so we upload them once here
+        updateUniformBlocks(camera, VP, eye);
+        // The frame is described as a graph of passes (see "render-graph.hpp"): the scene pass draws to the output directly,
+        // or to transient textures when the postprocessing is active, then the postprocess passes draw them to the output.
+        // When the scene is drawn at a scaled size, it always goes to transient textures of that size and the postprocess
+        // pass (or a plain upsample pass) stretches it over the output.
+        // The output is the framebuffer bound when "render" is called (the window unless the caller bound another one).
+        GLint outputFramebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outputFramebuffer);
+        renderGraph.clear();
+        RenderResource output = renderGraph.importFramebuffer("Output", (GLuint)outputFramebuffer, windowSize);
+        bool postprocess = (postprocessMaterial || postprocessChain.isEnabled()) && dummy;
+        RenderResource sceneColor = output, sceneDepth = output;
+        renderGraph.addPass(
+            "Scene",
+            [&](RenderGraph::PassBuilder &builder)
+            {
+                if (postprocess || scaled)
+                {
+                    sceneColor = builder.create("Scene Color", {renderSize, GL_RGBA8});
+                    sceneDepth = builder.create("Scene Depth", {renderSize, GL_DEPTH_COMPONENT24});
+                }
+                else
+                    builder.write(output);
+            },
+            [&](const RenderGraph::PassResources &)
+            { renderScene(VP, eye); });
+        if (postprocess && postprocessChain.isEnabled())
+            postprocessChain.addPasses(renderGraph, sceneColor, sceneDepth, output, renderSize, passTimers, POSTPROCESS_TIMER);
+        else if (postprocess)
+            renderGraph.addPass(
+                "Postprocess",
+                [&](RenderGraph::PassBuilder &builder)
+                {
+                    builder.read(sceneColor);
+                    builder.write(output);
+                },
+                [&](const RenderGraph::PassResources &resources)
+                { renderPostprocess(resources.getTexture(sceneColor)); });
+        else if (scaled)
+            renderGraph.addPass(
+                "Upsample",
+                [&](RenderGraph::PassBuilder &builder)
+                {
+                    builder.read(sceneColor);
+                    builder.write(output);
+                },
+                [&](const RenderGraph::PassResources &resources)
+                { renderUpsample(resources.getTexture(sceneColor)); });
+        renderGraph.compile();
+        renderGraph.execute(renderTargets);
+    }
+
+    // Draws the opaque objects, the sky and the transparent objects to the bound framebuffer
+    void ForwardRenderer::renderScene(const glm::mat4 &VP, const glm::vec3 &eye)
+    {
+        RECORD_ZONE("ForwardRenderer::renderScene");
+        // The render graph already bound the target of the scene and set the viewport to its size
         // TODO: (Req 9) Set the clear color to black and the clear depth to 1
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClearDepth(1.0);
         //TODO: (Req 9) Set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
         // glColorMask controls which color channels (red, green, blue, and alpha) are enabled for writing. 
-        glColorMask(true, true, true, true);
-        glDepthMask(true);
+        GLStateCache::colorMask(glm::bvec4(true, true, true, true));
+        GLStateCache::depthMask(true);
 
-        // If there is a postprocess material, bind the framebuffer
-        if(postprocessMaterial && dummy){
-            //TODO: (Req 11) bind the framebuffer
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
-        }
         // TODO: (Req 9) Clear the color and depth buffers
         // If you have depth testing enabled you should also clear the depth buffer before each frame using GL_DEPTH_BUFFER_BIT; otherwise you're stuck with the depth values from last frame:
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // TODO: (Req 9) Draw all the opaque commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
+        // The opaque commands can be drawn in any order (the depth test takes care of visibility), so we sort them
+        // such that the commands sharing the same material and mesh are next to each other. Each run of such
+        // commands can then be drawn using a single instanced draw call (if the material has an instanced shader).
+        std::sort(opaqueCommands.begin(), opaqueCommands.end(), [](const RenderCommand &first, const RenderCommand &second)
+                  {
+            if (first.material != second.material) return first.material < second.material;
+            if (first.mesh != second.mesh) return first.mesh < second.mesh;
+            return first.lod < second.lod; });
+
+        // Finds where the run of commands with the same material, mesh and level of detail (starting at "runStart") ends
+        auto findRunEnd = [this](size_t runStart)
+        {
+            size_t runEnd = runStart + 1;
+            while (runEnd < opaqueCommands.size() &&
+                   opaqueCommands[runEnd].material == opaqueCommands[runStart].material &&
+                   opaqueCommands[runEnd].mesh == opaqueCommands[runStart].mesh &&
+                   opaqueCommands[runEnd].lod == opaqueCommands[runStart].lod)
+                runEnd++;
+            return runEnd;
+        };
+        // Returns true if the run is drawn with one instanced draw call (the pre-pass must decide like the main pass,
+        // since the instanced and the plain shaders may not compute the exact same depths)
+        // Without the clusters, every lit object gets the lights nearest to it. A run can cover the whole maze,
+        // so one set of lights for all its instances would drop the local lights, and the lit runs are drawn per object.
+        auto isInstanced = [this](size_t runStart, size_t runEnd)
+        {
+            Material *material = opaqueCommands[runStart].material;
+            return instancing && material->instancedShader && runEnd - runStart > 1 &&
+                   (clusteredThisFrame || !dynamic_cast<LitMaterial *>(material));
+        };
+
+        // The depth pre-pass draws the depth of the lit objects without any color, using the same runs as the main pass
+        if (depthPrepass)
+        {
+            passTimers.begin(DEPTH_PREPASS_TIMER);
+            for (size_t runStart = 0; runStart < opaqueCommands.size();)
+            {
+                size_t runEnd = findRunEnd(runStart);
+                Material *material = opaqueCommands[runStart].material;
+                Mesh *mesh = opaqueCommands[runStart].mesh;
+                if (!isPrepassed(material))
+                {
+                    runStart = runEnd;
+                    continue;
+                }
+                // The pipeline state still picks the depth function and the culled faces, but nothing is written to the colors
+                material->pipelineState.setup();
+                GLStateCache::colorMask(glm::bvec4(false));
+                GLStateCache::depthMask(true);
+                if (isInstanced(runStart, runEnd))
+                {
+                    uploadInstances(runStart, runEnd);
+                    depthInstancedShader->use();
+                    mesh->drawInstanced((GLsizei)instances.size(), opaqueCommands[runStart].lod);
+                }
+                else
+                {
+                    depthShader->use();
+                    const ObjectUniforms &uniforms = getUniforms(depthShader);
+                    for (size_t index = runStart; index < runEnd; index++)
+                    {
+                        depthShader->set(uniforms.M, opaqueCommands[index].localToWorld);
+                        mesh->draw(opaqueCommands[index].lod);
+                    }
+                }
+                runStart = runEnd;
+            }
+            GLStateCache::colorMask(glm::bvec4(true));
+        }
+
+        passTimers.begin(OPAQUE_TIMER);
         glm::mat4 MVP_O;
-        for (auto command : opaqueCommands)
+        for (size_t runStart = 0; runStart < opaqueCommands.size();)
         {
-            // use MVP matrix to draw to object in its right place
-             command.material->setup();
-            MVP_O = VP * command.localToWorld;
-            // if the material of the object is lighted
-            if (auto light_material = dynamic_cast<LitMaterial *>(command.material); light_material)
+            size_t runEnd = findRunEnd(runStart);
+            Material *material = opaqueCommands[runStart].material;
+            Mesh *mesh = opaqueCommands[runStart].mesh;
+            // The pre-passed objects already have their depth, so only their visible pixels are shaded
+            bool prepassed = depthPrepass && isPrepassed(material);
+            if (isInstanced(runStart, runEnd))
             {
-                    
-                light_material->shader->set("VP", VP);
-                light_material->shader->set("M", command.localToWorld);
-                light_material->shader->set("eye", eye);
-                light_material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
-                light_material->shader->set("light_count", (int)lightSources.size());
-                
-                for (int i = 0; i < (int)lightSources.size(); i++)
+                // Collect the model matrices of the whole run into the instance buffer
+                uploadInstances(runStart, runEnd);
+
+                material->setup(true);
+                if (prepassed)
                 {
-                  if(lightSources[i]->lightType >=0){
-                      // calculate position and direction of the light source based on the object
-                    glm::vec3 position = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,0,0,1);
-                    glm::vec3 direction = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,-1,0,0);
-                    
-                    light_material->shader->set("lights[" + std::to_string(i) + "].direction",direction);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].color",lightSources[i]->color);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].type", lightSources[i]->lightType);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].position", position); 
-                    light_material->shader->set("lights[" + std::to_string(i) + "].diffuse", lightSources[i]->diffuse);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].specular", lightSources[i]->specular);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].attenuation", lightSources[i]->attenuation);
-                    light_material->shader->set("lights[" + std::to_string(i) + "].cone_angles", lightSources[i]->cone_angles);
-                    
-                }}
+                    GLStateCache::depthFunc(GL_EQUAL);
+                    GLStateCache::depthMask(false);
+                }
+                // The model matrices come from the instance buffer and the rest (with the lights) from the uniform blocks
+                mesh->drawInstanced((GLsizei)instances.size(), opaqueCommands[runStart].lod);
+                runStart = runEnd;
+                continue;
             }
-            else
+
+            for (size_t index = runStart; index < runEnd; index++)
             {
-                command.material->shader->set("transform", MVP_O);
+                const RenderCommand &command = opaqueCommands[index];
+                // use MVP matrix to draw to object in its right place
+                command.material->setup();
+                if (prepassed)
+                {
+                    GLStateCache::depthFunc(GL_EQUAL);
+                    GLStateCache::depthMask(false);
+                }
+                MVP_O = VP * command.localToWorld;
+                // if the material of the object is lighted
+                ShaderProgram *shader = command.material->shader;
+                const ObjectUniforms &uniforms = getUniforms(shader);
+                if (auto light_material = dynamic_cast<LitMaterial *>(command.material); light_material)
+                {
+                    // The camera and the lights come from the uniform blocks, so we only send the model matrices
+                    // (and the indices of the lights that affect this object if the clusters are not used)
+                    shader->set(uniforms.M, command.localToWorld);
+                    shader->set(uniforms.M_IT, glm::transpose(glm::inverse(command.localToWorld)));
+                    if (!clusteredThisFrame)
+                        setObjectLights(shader, uniforms, command.bounds);
+                }
+                else
+                {
+                    shader->set(uniforms.transform, MVP_O);
+                }
+
+                command.mesh->draw(command.lod);
             }
-                        
-            command.mesh->draw();
+            runStart = runEnd;
         }
 
         // If there is a sky material, draw the sky
         if (this->skyMaterial)
         {
+            passTimers.begin(SKY_TIMER);
             //TODO: (Req 10) setup the sky material
             //this function sets up the sky attributes as a textured material 
             // it calls the setup function of the textured material
@@ -302,44 +570,380 @@ namespace our
             );
              //TODO: (Req 10) set the "transform" uniform
             // here we are setting the uniform transform by our mvp matrix (so we first multiply by the model matrix , then VP=P*V , so we get mvp = p*v*m , then we multiply by the matrix always behind the scene which forces the sky to always be behind anything having z=1)
-            skyMaterial->shader->set("transform", alwaysBehindTransform * VP * skyModel);
+            skyMaterial->shader->set(getUniforms(skyMaterial->shader).transform, alwaysBehindTransform * VP * skyModel);
              //TODO: (Req 10) draw the sky sphere
             // calling mesh draw to draw the sky
             skySphere->draw();
         }
         // TODO: (Req 9) Draw all the transparent commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
+        passTimers.begin(TRANSPARENT_TIMER);
         glm::mat4 MVP_T;
         for (auto command : transparentCommands)
         {
             command.material->setup();
             MVP_T = VP * command.localToWorld;
-            command.material->shader->set("transform", MVP_T);
-            command.mesh->draw();
+            command.material->shader->set(getUniforms(command.material->shader).transform, MVP_T);
+            command.mesh->draw(command.lod);
+        }
+        passTimers.end();
+    }
+
+    // Applies the postprocessing effect to the scene color and draws the result to the bound framebuffer
+    void ForwardRenderer::renderPostprocess(Texture2D *sceneColor)
+    {
+        RECORD_ZONE("ForwardRenderer::renderPostprocess");
+        passTimers.begin(POSTPROCESS_TIMER);
+
+        GLStateCache::activeTexture(1);
+        Distorsion->bind();
+        postprocessMaterial->sampler->bind(1);
+        postprocessMaterial->shader->set("additional_sampler",1);
+
+
+        // The render graph already bound the output (the window by default) and the scene color is sampled from "sceneColor"
+        //TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
+        postprocessMaterial->texture = sceneColor;
+        postprocessMaterial->setup();
+        GLStateCache::bindVertexArray(postProcessVertexArray);
+        glDrawArrays(GL_TRIANGLES,0,3);
+        FrameStats::countDraw(1);
+
+        // if  there is a light material apply it
+        if (lightMaterial)
+        {
+            lightMaterial->setup();
+        }
+        passTimers.end();
+    }
+
+    // Stretches the scaled scene color over the bound framebuffer (used by the dynamic resolution without postprocessing)
+    void ForwardRenderer::renderUpsample(Texture2D *sceneColor)
+    {
+        passTimers.begin(UPSAMPLE_TIMER);
+        PipelineState pipelineState;
+        pipelineState.depthMask = false;
+        pipelineState.setup();
+        upsampleShader->use();
+        GLStateCache::activeTexture(0);
+        sceneColor->bind();
+        upsampleSampler->bind(0);
+        GLStateCache::bindVertexArray(upsampleVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        FrameStats::countDraw(1);
+        passTimers.end();
+    }
+
+    // Builds the commands of the entities in [begin, end) of "extractionEntities" and collects their visible lights
+    void ForwardRenderer::extractCommands(size_t begin, size_t end, ExtractedCommands &commands)
+    {
+        PROFILE_SCOPE("ForwardRenderer::extractCommands");
+        for (size_t index = begin; index < end; index++)
+        {
+            Entity *entity = extractionEntities[index];
+            // If this entity has a mesh renderer component
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            // Static opaque entities are already part of the static batches, so we skip them
+            if (meshRenderer && staticBatchesBuilt && meshRenderer->isStatic && !meshRenderer->material->transparent)
+                meshRenderer = nullptr;
+            if (meshRenderer)
+            {
+                // We construct a command from it
+                RenderCommand command;
+                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
+                command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
+                command.mesh = meshRenderer->mesh;
+                command.material = meshRenderer->material;
+                command.id = (uint32_t)index;
+                computeBounds(command);
+                // Skip the objects that are hidden behind the maze walls
+                if (!pvs.isVisible(command.boxMin, command.boxMax) || !occlusion.isVisible(command.boxMin, command.boxMax))
+                {
+                    commands.culled++;
+                    continue;
+                }
+                if (lodEnabled)
+                {
+                    meshRenderer->updateLOD(lodSettings, getScreenSize(command.bounds));
+                    command.lod = meshRenderer->lod;
+                }
+                // if it is transparent, we add it to the transparent commands list
+                if (command.material->transparent)
+                {
+                    commands.transparent.push_back(command);
+                }
+                else
+                {
+                    // Otherwise, we add it to the opaque command list
+                    commands.opaque.push_back(command);
+                }
+            }
+            // if light component store it
+            if (auto lightComp = entity->getComponent<LightComponent>(); lightComp)
+            {
+                // A light whose range only touches hidden cells can't light anything we see
+                glm::vec3 position = entity->getLocalToWorldMatrix() * glm::vec4(0, 0, 0, 1);
+                float range = lightComp->getRange();
+                if (pvs.isVisible(position - range, position + range))
+                    commands.lights.push_back(lightComp);
+            }
+        }
+    }
+
+    // Returns true if the material is drawn in the depth pre-pass (only lit opaque materials that write to the depth buffer)
+    bool ForwardRenderer::isPrepassed(const Material *material) const
+    {
+        // The lit shaders compute their position exactly like the depth shaders (see "depth.vert"), and they are the
+        // expensive ones. Other materials may compute their position differently, so GL_EQUAL could reject their pixels.
+        return !material->transparent && dynamic_cast<const LitMaterial *>(material) &&
+               material->pipelineState.depthTesting.enabled && material->pipelineState.depthMask;
+    }
+
+    // Fills the instance buffer with the model matrices of the given run of opaque commands and attaches it to their mesh
+    void ForwardRenderer::uploadInstances(size_t runStart, size_t runEnd)
+    {
+        instances.clear();
+        for (size_t index = runStart; index < runEnd; index++)
+        {
+            const glm::mat4 &M = opaqueCommands[index].localToWorld;
+            instances.push_back({M, glm::transpose(glm::inverse(M))});
         }
+        GLintptr offset = streamBuffer.upload(instances.data(), instances.size() * sizeof(InstanceData), sizeof(glm::vec4));
+        opaqueCommands[runStart].mesh->bindInstanceBuffer(streamBuffer.getBuffer(), offset);
+    }
+
+    // Returns the uniform handles of the given shader (resolving them the first time the shader is seen)
+    const ObjectUniforms &ForwardRenderer::getUniforms(ShaderProgram *shader)
+    {
+        auto it = shaderUniforms.find(shader);
+        if (it != shaderUniforms.end())
+            return it->second;
+        // Unused uniforms get a location of -1 which is ignored by OpenGL, so it is fine to resolve all of them for every shader
+        ObjectUniforms uniforms;
+        uniforms.M = shader->getUniform<glm::mat4>("M");
+        uniforms.M_IT = shader->getUniform<glm::mat4>("M_IT");
+        uniforms.transform = shader->getUniform<glm::mat4>("transform");
+        uniforms.objectLights = shader->getUniform<GLint>("object_lights");
+        uniforms.objectLightCount = shader->getUniform<GLint>("object_light_count");
+        return shaderUniforms.emplace(shader, uniforms).first->second;
+    }
+
+    // Computes the world space bounding sphere and box of the command mesh
+    void ForwardRenderer::computeBounds(RenderCommand &command)
+    {
+        glm::vec4 sphere = command.mesh->getBoundingSphere();
+        const glm::mat4 &M = command.localToWorld;
+        // The radius grows with the largest scale of the model matrix
+        float scale = glm::max(glm::length(glm::vec3(M[0])), glm::max(glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))));
+        command.bounds = glm::vec4(glm::vec3(M * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w * scale);
+        // The box is transformed by moving its center then projecting its half extent on the world axes
+        Mesh *mesh = command.mesh;
+        glm::vec3 center = glm::vec3(mesh->minX + mesh->maxX, mesh->minY + mesh->maxY, mesh->minZ + mesh->maxZ) * 0.5f;
+        glm::vec3 extent = glm::vec3(mesh->maxX - mesh->minX, mesh->maxY - mesh->minY, mesh->maxZ - mesh->minZ) * 0.5f;
+        glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(M[0])), glm::abs(glm::vec3(M[1])), glm::abs(glm::vec3(M[2])));
+        center = glm::vec3(M * glm::vec4(center, 1.0f));
+        extent = absolute * extent;
+        command.boxMin = center - extent;
+        command.boxMax = center + extent;
+    }
+
+    // Returns the size of the given world space bounding sphere on the screen (its diameter divided by the viewport height)
+    float ForwardRenderer::getScreenSize(const glm::vec4 &bounds) const
+    {
+        if (!lodPerspective)
+            return bounds.w * lodScale;
+        // The projected height of a sphere is about 2r / (2d * tan(fovY / 2)), and it fills the screen once the camera is inside it
+        float distance = glm::distance(glm::vec3(bounds), lodEye);
+        if (distance <= bounds.w)
+            return std::numeric_limits<float>::infinity();
+        return bounds.w * lodScale / distance;
+    }
 
-        // If there is a postprocess material and dummy flag is true, apply postprocessing effect
-        if(postprocessMaterial && dummy){
+    // Sends the indices of the lights that affect the given world space bounding sphere (used when the clusters are not)
+    void ForwardRenderer::setObjectLights(ShaderProgram *shader, const ObjectUniforms &uniforms, const glm::vec4 &bounds)
+    {
+        GLint lights[MAX_OBJECT_LIGHTS];
+        int count = lightCuller.query(glm::vec3(bounds), bounds.w, lights, MAX_OBJECT_LIGHTS);
+        shader->set(uniforms.objectLightCount, count);
+        if (count > 0)
+            shader->set(uniforms.objectLights, lights, count);
+    }
 
-            glActiveTexture(GL_TEXTURE1);
-            Distorsion->bind();
-            postprocessMaterial->sampler->bind(1);
-            postprocessMaterial->shader->set("additional_sampler",1);
+    // Fills the frame, lights and clusters uniform buffers with the camera and the lights data then binds them
+    void ForwardRenderer::updateUniformBlocks(CameraComponent *camera, const glm::mat4 &VP, const glm::vec3 &eye)
+    {
+        RECORD_ZONE("ForwardRenderer::updateUniformBlocks");
+        // Every block is written to the stream buffer then bound by its offset
+        // (the buffer may be replaced by a larger one while writing, so we keep the buffer of every block too)
+        frameBlock.VP = VP;
+        frameBlock.eye = eye;
+        GLintptr frameOffset = streamBuffer.upload(&frameBlock, sizeof(FrameBlock), uniformAlignment);
+        GLuint frameBuffer = streamBuffer.getBuffer();
+
+        // The clusters are slices of a perspective frustum, so an orthographic camera uses the Lights block instead
+        ClustersBlock clustersBlock = ClustersBlock();
+        clusteredThisFrame = clusteredLighting && camera->cameraType == CameraType::PERSPECTIVE;
+        int count = 0;
+        if (clusteredThisFrame)
+        {
+            lightClusters.update(lightSources, camera->getViewMatrix(), camera->getProjectionMatrix(windowSize),
+                                 camera->near, camera->far, glm::ivec4(0, 0, renderSize.x, renderSize.y));
+            lightClusters.bind();
+            clustersBlock = lightClusters.getBlock();
+        }
+        else
+        {
+            // Only the visible lights are sent, then every object picks its lights from them (see "setObjectLights")
+            lightCuller.update(lightSources, VP, MAX_LIGHTS);
+            const auto &visibleLights = lightCuller.getLights();
+            count = (int)visibleLights.size();
+            for (int i = 0; i < count; i++)
+            {
+                const LightCuller::VisibleLight &visible = visibleLights[i];
+                LightData &data = lightsBlock.lights[i];
+                data.type = visible.light->lightType;
+                data.position = visible.position;
+                data.direction = visible.direction;
+                data.diffuse = visible.light->diffuse;
+                data.specular = visible.light->specular;
+                data.attenuation = visible.light->attenuation;
+                data.coneAngles = visible.light->cone_angles;
+            }
+        }
+        lightsBlock.lightCount = count;
+        // The whole block is bound (the shaders declare all of it) but only the used part of the light array is written
+        // When the clusters are used, the block is still bound (with no lights) since the shaders declare it
+        GLintptr lightsOffset;
+        auto *lights = (LightsBlock *)streamBuffer.map(sizeof(LightsBlock), uniformAlignment, lightsOffset);
+        std::memcpy(lights->lights, lightsBlock.lights, count * sizeof(LightData));
+        lights->lightCount = count;
+        streamBuffer.unmap();
+        GLuint lightsBuffer = streamBuffer.getBuffer();
+        GLintptr clustersOffset = streamBuffer.upload(&clustersBlock, sizeof(ClustersBlock), uniformAlignment);
+        GLuint clustersBuffer = streamBuffer.getBuffer();
+
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, frameBuffer, frameOffset, sizeof(FrameBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BLOCK_BINDING, lightsBuffer, lightsOffset, sizeof(LightsBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, CLUSTERS_BLOCK_BINDING, clustersBuffer, clustersOffset, sizeof(ClustersBlock));
+    }
 
+    void ForwardRenderer::buildStaticBatches(World *world)
+    {
+        PROFILE_SCOPE("ForwardRenderer::buildStaticBatches");
+        clearStaticBatches();
 
-            //TODO: (Req 11) Return to the default framebuffer
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);       
-            //TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-            postprocessMaterial->setup();
-            glBindVertexArray(postProcessVertexArray);
-            glDrawArrays(GL_TRIANGLES,0,3);
+        // The vertices and the elements of every level of detail of a mesh
+        struct MeshData
+        {
+            std::vector<Vertex> vertices;
+            std::vector<std::vector<unsigned int>> levels;
+        };
+        // An entity merged into a batch: its mesh data, the index of its first vertex in the batch and whether its triangles are flipped
+        struct Part
+        {
+            const MeshData *data;
+            unsigned int base;
+            bool flip;
+        };
+        // The merged geometry of each batch, identified by its material and the XZ coordinates of its chunk
+        struct Batch
+        {
+            std::vector<Vertex> vertices;
+            std::vector<Part> parts;
+            glm::vec3 min = glm::vec3(FLT_MAX), max = glm::vec3(-FLT_MAX);
+        };
+        std::map<std::tuple<Material *, int, int>, Batch> batches;
+        // Many entities share the same mesh, so we only read each mesh back from the VRAM once
+        std::unordered_map<Mesh *, MeshData> meshData;
 
-            // if  there is a light material apply it
-            if (lightMaterial)
+        for (auto entity : world->getEntities())
+        {
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            // Transparent objects must be sorted every frame so they can't be merged
+            if (!meshRenderer || !meshRenderer->isStatic || !meshRenderer->mesh || meshRenderer->material->transparent)
+                continue;
+            auto [data, inserted] = meshData.try_emplace(meshRenderer->mesh);
+            if (inserted)
+            {
+                Mesh *mesh = meshRenderer->mesh;
+                data->second.levels.resize(mesh->getLODCount());
+                for (int level = 0; level < mesh->getLODCount(); level++)
+                    mesh->readBack(data->second.vertices, data->second.levels[level], level);
+            }
+            const std::vector<Vertex> &vertices = data->second.vertices;
+
+            // Pick the batch based on the material and the chunk in which the entity origin lies
+            glm::mat4 M = entity->getLocalToWorldMatrix();
+            glm::vec3 origin = M * glm::vec4(0, 0, 0, 1);
+            glm::ivec2 chunk(0, 0);
+            if (staticChunkSize > 0)
+                chunk = glm::ivec2(glm::floor(glm::vec2(origin.x, origin.z) / staticChunkSize));
+            Batch &batch = batches[{meshRenderer->material, chunk.x, chunk.y}];
+
+            // Transform the vertices to the world space (the normals are transformed by the inverse-transpose)
+            glm::mat3 M_IT = glm::transpose(glm::inverse(glm::mat3(M)));
+            auto base = (unsigned int)batch.vertices.size();
+            for (Vertex vertex : vertices)
             {
-                lightMaterial->setup();
+                vertex.position = glm::vec3(M * glm::vec4(vertex.position, 1.0f));
+                vertex.normal = glm::normalize(M_IT * vertex.normal);
+                batch.min = glm::min(batch.min, vertex.position);
+                batch.max = glm::max(batch.max, vertex.position);
+                batch.vertices.push_back(vertex);
             }
+            // A mirroring transformation (negative determinant) flips the winding of the triangles,
+            // so we swap two vertices of each triangle to keep the front faces pointing outward
+            batch.parts.push_back({&data->second, base, glm::determinant(glm::mat3(M)) < 0});
+        }
+
+        // Upload each batch into its own mesh. Since the vertices are already in the world space, the model matrix is the identity.
+        for (auto &[key, batch] : batches)
+        {
+            // Level "i" of the batch merges level "i" of every part (or its last level if it has fewer levels)
+            size_t levelCount = 0;
+            for (const Part &part : batch.parts)
+                levelCount = std::max(levelCount, part.data->levels.size());
+            std::vector<std::vector<unsigned int>> levels(levelCount);
+            for (size_t level = 0; level < levelCount; level++)
+                for (const Part &part : batch.parts)
+                {
+                    const std::vector<unsigned int> &elements = part.data->levels[std::min(level, part.data->levels.size() - 1)];
+                    for (size_t i = 0; i + 2 < elements.size(); i += 3)
+                    {
+                        levels[level].push_back(part.base + elements[i]);
+                        levels[level].push_back(part.base + elements[part.flip ? i + 2 : i + 1]);
+                        levels[level].push_back(part.base + elements[part.flip ? i + 1 : i + 2]);
+                    }
+                }
+            if (levels.empty() || levels[0].empty())
+                continue;
+            std::vector<unsigned int> elements = std::move(levels[0]);
+            levels.erase(levels.begin());
+
+            RenderCommand command;
+            command.localToWorld = glm::mat4(1.0f);
+            command.center = (batch.min + batch.max) * 0.5f;
+            command.mesh = new Mesh(batch.vertices, elements, levels);
+            command.material = std::get<0>(key);
+            computeBounds(command);
+            staticCommands.push_back(command);
         }
+        staticBatchesBuilt = true;
+    }
+
+    void ForwardRenderer::clearStaticBatches()
+    {
+        for (auto &command : staticCommands)
+            delete command.mesh;
+        staticCommands.clear();
+        staticBatchesBuilt = false;
+    }
+
+    void ForwardRenderer::buildVisibility(World *world)
+    {
+        PROFILE_SCOPE("ForwardRenderer::buildVisibility");
+        if (pvsEnabled)
+            pvs.build(world);
     }
 
-}
\ No newline at end of file
+}
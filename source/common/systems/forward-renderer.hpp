@@ -6,22 +6,32 @@
 #include "../components/mesh-renderer.hpp"
 #include "../asset-loader.hpp"
 #include "../material/material.hpp"
+#include "light-clusters.hpp"
+#include "light-culling.hpp"
+#include "potentially-visible-set.hpp"
+#include "software-occlusion.hpp"
+#include "render-command.hpp"
+#include "transparent-sorter.hpp"
+#include "postprocess-chain.hpp"
+#include "dynamic-resolution.hpp"
+#include "../gpu-timers.hpp"
+#include "../stream-buffer.hpp"
+#include "../render-graph/render-graph.hpp"
 
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
 
 namespace our
 {
     
-    // The render command stores command that tells the renderer that it should draw
-    // the given mesh at the given localToWorld matrix using the given material
-    // The renderer will fill this struct using the mesh renderer components
-    struct RenderCommand {
-        glm::mat4 localToWorld;
-        glm::vec3 center;
-        Mesh* mesh;
-        Material* material;
+    // The per-object uniform handles used by the renderer
+    // They are resolved once per shader so that drawing doesn't look up the uniforms by name every time
+    // (The camera and the lights are not here since they are sent once per frame in uniform blocks)
+    struct ObjectUniforms {
+        UniformHandle<glm::mat4> M, M_IT, transform;
+        UniformHandle<GLint> objectLights, objectLightCount;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -35,15 +45,55 @@ namespace our
         // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
+        TransparentSorter transparentSorter;
+        // The commands are extracted from the entities on all the threads (see "job-system.hpp"). The entities are split
+        // into chunks of a fixed size where every chunk fills its own lists, then the lists are merged in the order of the
+        // chunks into the ones above before drawing. So the merged lists are in the order of the entities whatever thread
+        // took each chunk (the transparent commands at the same depth and the lights that fit in the capped light lists
+        // would change from frame to frame otherwise).
+        struct ExtractedCommands {
+            std::vector<RenderCommand> opaque, transparent;
+            std::vector<LightComponent*> lights;
+            size_t culled = 0; // The number of commands skipped by the culling
+        };
+        std::vector<ExtractedCommands> chunkCommands;
+        // The entities of the world copied into an array so that they can be split into chunks
+        std::vector<Entity*> extractionEntities;
+        // The number of entities in a chunk (smaller chunks cost more to schedule than to process)
+        static constexpr size_t EXTRACTION_CHUNK_SIZE = 256;
+        // Objects used for hardware instancing
+        // Opaque commands sharing the same mesh and material are drawn in one instanced draw call
+        // where the model matrices are read from the stream buffer
+        // (except the lit ones when the clusters are off, since every lit object then needs its own lights)
+        bool instancing = true;
+        std::vector<InstanceData> instances;
+        // The instances and the uniform blocks change every frame, so they are written to a stream buffer
+        // (see "stream-buffer.hpp") instead of being re-uploaded into buffers of their own
+        StreamBuffer streamBuffer;
+        // The uniform blocks must start at a multiple of this (queried from the driver)
+        GLint uniformAlignment = 256;
+        // The number of bytes expected to be streamed every frame (the stream buffer grows if more is needed)
+        static constexpr GLsizeiptr STREAM_FRAME_SIZE = 2 << 20;
+        // Objects used for static batching
+        // The opaque static entities are merged at load time into one mesh per material and spatial chunk
+        // The chunks are squares (on the XZ plane) whose side is "staticChunkSize" (0 means one chunk for everything)
+        float staticChunkSize = 8.0f;
+        bool staticBatchesBuilt = false;
+        std::vector<RenderCommand> staticCommands; // The meshes of these commands are owned by the renderer
         // Objects used for rendering a skybox
-        Mesh* skySphere;
-        TexturedMaterial* skyMaterial;
+        Mesh* skySphere = nullptr;
+        TexturedMaterial* skyMaterial = nullptr;
         // Objects used for Postprocessing
-        GLuint postprocessFrameBuffer, postProcessVertexArray;
-        Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial* postprocessMaterial;
+        GLuint postProcessVertexArray;
+        TexturedMaterial* postprocessMaterial = nullptr;
+        // A chain of fused postprocessing effects (see "postprocess-chain.hpp")
+        // If the configuration has a "postprocessChain", it is used instead of the single "postprocess" shader
+        PostprocessChain postprocessChain;
+        // The passes of the frame and the textures they draw to (see "render-graph.hpp")
+        RenderGraph renderGraph;
+        RenderTargetPool renderTargets;
         // Objects used for distortion
-        Texture2D* Distorsion;
+        Texture2D* Distorsion = nullptr;
         //Dummy variable to switch between postprocessing effects
         bool dummy=false;
         // Objects used to support lighting
@@ -53,9 +103,80 @@ namespace our
         glm::vec3 skyMiddle;
         glm::vec3 skyBottom;
 
+        // The uniform handles of every shader the renderer has drawn with (filled lazily by "getUniforms")
+        std::unordered_map<ShaderProgram*, ObjectUniforms> shaderUniforms;
+        // The camera and the lights data (see "uniform-blocks.hpp"), they are written to the stream buffer every frame
+        FrameBlock frameBlock;
+        LightsBlock lightsBlock;
+        // Clustered lighting lets the lit shaders handle hundreds of lights (see "light-clusters.hpp")
+        // It can be disabled from the configuration, then only the first MAX_LIGHTS lights are used
+        bool clusteredLighting = true;
+        LightClusters lightClusters;
+        // When the clusters are not used (disabled or orthographic camera), every lit object gets the few lights
+        // that affect it most from this culler (see "light-culling.hpp")
+        bool clusteredThisFrame = false;
+        LightCuller lightCuller;
+        // The baked visibility of the maze (see "potentially-visible-set.hpp")
+        // It is only used if the configuration has a "pvs" object and "buildVisibility" was called
+        bool pvsEnabled = false;
+        PotentiallyVisibleSet pvs;
+        // The occlusion culling of moving scenes (see "software-occlusion.hpp")
+        // It is only used if the configuration has an "occlusion" object
+        SoftwareOcclusion occlusion;
+        // The meshes that are small on the screen are drawn using their simplified levels of detail
+        // It is only used if the configuration has a "lod" object (which can override the LODSettings values)
+        bool lodEnabled = false;
+        LODSettings lodSettings;
+        // The camera data needed to compute the screen size of the objects (updated every frame)
+        glm::vec3 lodEye = glm::vec3(0);
+        bool lodPerspective = true;
+        float lodScale = 1.0f;
+        // The depth pre-pass draws the depth of the lit opaque objects first (with a position-only shader), so the
+        // expensive lighting shader then only runs once per pixel (with GL_EQUAL depth testing and no depth writes)
+        // It is only used if "depthPrepass" is true in the configuration
+        bool depthPrepass = false;
+        ShaderProgram *depthShader = nullptr, *depthInstancedShader = nullptr;
+        // The GPU time spent in every pass of the frame (see "PassTimer" for their order)
+        GPUTimers passTimers;
+        // The scene is drawn at a scaled size that follows the GPU time of the frames (see "dynamic-resolution.hpp")
+        // It is only used if the configuration has a "dynamicResolution" object. The scaled scene is upsampled to the
+        // output by the postprocess pass, or by a plain upsample pass (with "upsampleShader") when there is no postprocessing.
+        DynamicResolution dynamicResolution;
+        glm::ivec2 renderSize;
+        ShaderProgram *upsampleShader = nullptr;
+        Sampler *upsampleSampler = nullptr;
+        GLuint upsampleVertexArray = 0;
+
+        // Builds the commands of the entities in [begin, end) of "extractionEntities" and collects their visible lights
+        // This runs on the worker threads, so it must not call OpenGL or touch anything shared without synchronization
+        void extractCommands(size_t begin, size_t end, ExtractedCommands& commands);
+        // Returns the uniform handles of the given shader (resolving them the first time the shader is seen)
+        const ObjectUniforms& getUniforms(ShaderProgram* shader);
+        // Computes the world space bounding sphere and box of the command mesh
+        static void computeBounds(RenderCommand& command);
+        // Returns true if the material is drawn in the depth pre-pass (only lit opaque materials that write to the depth buffer)
+        bool isPrepassed(const Material *material) const;
+        // Fills the instance buffer with the model matrices of the given run of opaque commands and attaches it to their mesh
+        void uploadInstances(size_t runStart, size_t runEnd);
+        // Returns the size of the given world space bounding sphere on the screen (its diameter divided by the viewport height)
+        float getScreenSize(const glm::vec4& bounds) const;
+        // Sends the indices of the lights that affect the given world space bounding sphere (used when the clusters are not)
+        void setObjectLights(ShaderProgram* shader, const ObjectUniforms& uniforms, const glm::vec4& bounds);
+        // Draws the opaque objects, the sky and the transparent objects to the bound framebuffer
+        void renderScene(const glm::mat4 &VP, const glm::vec3 &eye);
+        // Applies the postprocessing effect to the scene color and draws the result to the bound framebuffer
+        void renderPostprocess(Texture2D *sceneColor);
+        // Stretches the scaled scene color over the bound framebuffer (used by the dynamic resolution without postprocessing)
+        void renderUpsample(Texture2D *sceneColor);
+        // Writes the frame, lights and clusters uniform blocks with the camera and the lights data then binds them
+        // This is called once per frame, before drawing anything
+        void updateUniformBlocks(CameraComponent* camera, const glm::mat4& VP, const glm::vec3& eye);
         
 
     public:
+        // The passes whose GPU times are measured every frame
+        enum PassTimer { DEPTH_PREPASS_TIMER, OPAQUE_TIMER, SKY_TIMER, TRANSPARENT_TIMER, POSTPROCESS_TIMER, UPSAMPLE_TIMER };
+
         //Inverts between the postprocessing effects
         void invertDummyVariable(){dummy=!dummy;}
         // Initialize the renderer including the sky and the Postprocessing objects.
@@ -63,8 +184,34 @@ namespace our
         void initialize(glm::ivec2 windowSize, const nlohmann::json& config);
         // Clean up the renderer
         void destroy();
+        // Merges the meshes of all the opaque entities whose mesh renderer is static into a few large meshes
+        // (pre-transformed to the world space). This should be called once after the world is loaded.
+        // From then on, the static entities are drawn using the merged meshes instead of their own.
+        void buildStaticBatches(World* world);
+        // Deletes the merged meshes and goes back to drawing every static entity on its own
+        void clearStaticBatches();
+        // Bakes the potentially visible set of the static occluders (e.g. the maze walls) if it is enabled in the configuration
+        // This should be called once after the world is loaded. Then, the objects hidden behind the walls are not drawn.
+        void buildVisibility(World* world);
+        // Changes the size of the frames (the render targets of the old size are freed by the pool after a few frames)
+        void resize(glm::ivec2 windowSize) { this->windowSize = windowSize; }
+        // Finds the camera of the world, then culls, extracts and sorts the render commands (the CPU half of "render")
+        // It returns the camera (null if the world has none, so there is nothing to draw)
+        CameraComponent* buildCommands(World* world);
+        // Returns the commands built by the last call to "buildCommands"
+        size_t getOpaqueCommandCount() const { return opaqueCommands.size(); }
+        size_t getTransparentCommandCount() const { return transparentCommands.size(); }
         // This function should be called every frame to draw the given world
+        // The frame is drawn to the framebuffer bound when it is called (normally the window)
         void render(World* world);
+        // Returns the software occlusion culling statistics of the last frame
+        OcclusionStats getOcclusionStats() const { return occlusion.getStats(); }
+        // Returns the baked potentially visible set (for its statistics, it isn't built unless "pvs" is configured)
+        const PotentiallyVisibleSet& getVisibilitySet() const { return pvs; }
+        // Returns the GPU time of every pass (a few frames old, see "gpu-timers.hpp")
+        const GPUTimers& getPassTimers() const { return passTimers; }
+        // Returns the size the scene was drawn at in the last frame (smaller than the window with dynamic resolution)
+        glm::ivec2 getRenderSize() const { return renderSize; }
         /// read material sky from json
         void deserialize(const nlohmann::json &data) 
         {
@@ -0,0 +1,226 @@
+#include "light-clusters.hpp"
+#include "../ecs/entity.hpp"
+#include "../gl-state-cache.hpp"
+#include "../job-system.hpp"
+#include "../flight-recorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace our
+{
+
+    void LightClusters::initialize(const nlohmann::json &config)
+    {
+        if (config.contains("clusters"))
+        {
+            const auto &clusters = config["clusters"];
+            gridSize = glm::uvec3(clusters[0].get<uint32_t>(), clusters[1].get<uint32_t>(), clusters[2].get<uint32_t>());
+            gridSize = glm::max(gridSize, glm::uvec3(1));
+        }
+        uint32_t clusterCount = gridSize.x * gridSize.y * gridSize.z;
+        clusterCounts.assign(clusterCount, 0);
+        clusterSlots.assign((size_t)clusterCount * MAX_LIGHTS_PER_CLUSTER, 0);
+        clusterRanges.assign(clusterCount, glm::uvec2(0));
+
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+
+        // Each buffer texture is connected to its buffer once, then we only replace the buffer data every frame
+        GLuint *buffers[] = {&lightBuffer, &clusterBuffer, &indexBuffer};
+        GLuint *textures[] = {&lightTexture, &clusterTexture, &indexTexture};
+        GLenum formats[] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        GLuint units[] = {LIGHT_DATA_TEXTURE_UNIT, CLUSTER_DATA_TEXTURE_UNIT, LIGHT_INDICES_TEXTURE_UNIT};
+        for (int index = 0; index < 3; index++)
+        {
+            glGenBuffers(1, buffers[index]);
+            glBindBuffer(GL_TEXTURE_BUFFER, *buffers[index]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glGenTextures(1, textures[index]);
+            GLStateCache::activeTexture(units[index]);
+            glBindTexture(GL_TEXTURE_BUFFER, *textures[index]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[index], *buffers[index]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        GLStateCache::activeTexture(0);
+
+        block = ClustersBlock();
+    }
+
+    void LightClusters::destroy()
+    {
+        glDeleteTextures(1, &lightTexture);
+        glDeleteTextures(1, &clusterTexture);
+        glDeleteTextures(1, &indexTexture);
+        glDeleteBuffers(1, &lightBuffer);
+        glDeleteBuffers(1, &clusterBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        lightTexture = clusterTexture = indexTexture = 0;
+        lightBuffer = clusterBuffer = indexBuffer = 0;
+    }
+
+    void LightClusters::pushLightData(const LightComponent *light, const glm::mat4 &lightToWorld, float range)
+    {
+        // The layout must match "fetch_light" in "lighted.frag"
+        glm::vec3 position = lightToWorld * glm::vec4(0, 0, 0, 1);
+        glm::vec3 direction = lightToWorld * glm::vec4(0, -1, 0, 0);
+        lightData.push_back(glm::vec4(position, (float)light->lightType));
+        lightData.push_back(glm::vec4(direction, light->cone_angles.x));
+        lightData.push_back(glm::vec4(light->diffuse, light->cone_angles.y));
+        lightData.push_back(glm::vec4(light->specular, std::isinf(range) ? -1.0f : range));
+        lightData.push_back(glm::vec4(light->attenuation, 0.0f));
+    }
+
+    void LightClusters::update(const std::vector<LightComponent *> &lights, const glm::mat4 &V, const glm::mat4 &P,
+                               float near, float far, glm::ivec4 viewport)
+    {
+        RECORD_ZONE("LightClusters::update");
+        // The depth slices are exponential (thin near the camera and thick far away) so the clusters stay roughly cubic
+        float depthScale = (float)gridSize.z / std::log(far / near);
+        float depthBias = -std::log(near) * depthScale;
+        auto sliceOf = [&](float depth)
+        {
+            float slice = std::floor(std::log(glm::max(depth, near)) * depthScale + depthBias);
+            return (uint32_t)glm::clamp(slice, 0.0f, (float)gridSize.z - 1);
+        };
+        // The forward direction of the camera is the negative of the third row of the view matrix
+        block.cameraForward = glm::vec4(-V[0][2], -V[1][2], -V[2][2], 0.0f);
+        block.depth = glm::vec4(near, far, depthScale, depthBias);
+        block.viewport = glm::vec4(viewport);
+        block.grid = glm::uvec4(gridSize, 0);
+        block.enabled = 1;
+
+        // First, we add the global lights, then the lights that can be clustered
+        lightData.clear();
+        localLights.clear();
+        uint32_t lightCount = 0;
+        for (auto light : lights)
+        {
+            if (lightCount >= MAX_CLUSTERED_LIGHTS)
+                break;
+            if (light->lightType < 0)
+                continue;
+            float range = light->getRange();
+            if (!std::isinf(range))
+                continue;
+            pushLightData(light, light->getOwner()->getLocalToWorldMatrix(), range);
+            lightCount++;
+        }
+        uint32_t globalCount = lightCount;
+        for (auto light : lights)
+        {
+            if (lightCount >= MAX_CLUSTERED_LIGHTS)
+                break;
+            if (light->lightType <= 0)
+                continue;
+            float range = light->getRange();
+            if (std::isinf(range) || range <= 0)
+                continue;
+            glm::mat4 lightToWorld = light->getOwner()->getLocalToWorldMatrix();
+            glm::vec3 center = V * lightToWorld * glm::vec4(0, 0, 0, 1);
+            // The camera looks along -Z in the view space
+            float depth = -center.z;
+            // Skip the lights that are completely in front of the near plane or behind the far plane
+            if (depth + range < near || depth - range > far)
+                continue;
+            pushLightData(light, lightToWorld, range);
+            localLights.push_back({center, range, lightCount, sliceOf(depth - range), sliceOf(depth + range)});
+            lightCount++;
+        }
+
+        // Then we assign the local lights to the clusters. Every slice is only written by the job that owns it,
+        // so the jobs don't need any synchronization.
+        std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
+        if (!localLights.empty())
+        {
+            JobSystem::parallelFor(gridSize.z, 1, [&](size_t begin, size_t end, unsigned)
+                                   {
+                for (size_t slice = begin; slice < end; slice++)
+                    for (const auto &light : localLights)
+                        if (slice >= light.firstSlice && slice <= light.lastSlice)
+                            assignToSlice(light, (uint32_t)slice, P); });
+        }
+
+        // Finally, we pack the cluster lists one after the other
+        lightIndices.clear();
+        for (size_t cluster = 0; cluster < clusterCounts.size(); cluster++)
+        {
+            uint32_t offset = (uint32_t)lightIndices.size();
+            uint32_t count = std::min<uint32_t>(clusterCounts[cluster], (uint32_t)maxTexels - offset);
+            clusterRanges[cluster] = glm::uvec2(offset, count);
+            const uint32_t *slots = &clusterSlots[cluster * MAX_LIGHTS_PER_CLUSTER];
+            lightIndices.insert(lightIndices.end(), slots, slots + count);
+        }
+
+        // Upload everything (orphaning the old data store so we don't wait for the previous frame to finish reading it)
+        // A buffer texture can't be empty, so we always send at least one texel
+        glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(lightData.size(), 1) * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, lightData.size() * sizeof(glm::vec4), lightData.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, clusterRanges.size() * sizeof(glm::uvec2), clusterRanges.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(lightIndices.size(), 1) * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, lightIndices.size() * sizeof(uint32_t), lightIndices.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        block.grid.w = globalCount;
+    }
+
+    void LightClusters::assignToSlice(const LightBounds &light, uint32_t slice, const glm::mat4 &P)
+    {
+        float near = block.depth.x, far = block.depth.y;
+        // The part of the light sphere inside this slice is bounded by a view space box whose depth is the overlap
+        // between the slice and the sphere and whose width is the widest circle of the sphere in that overlap
+        float depth = -light.center.z;
+        float sliceNear = near * std::pow(far / near, (float)slice / gridSize.z);
+        float sliceFar = near * std::pow(far / near, (float)(slice + 1) / gridSize.z);
+        float boxNear = glm::max(sliceNear, depth - light.radius);
+        float boxFar = glm::min(sliceFar, depth + light.radius);
+        if (boxNear > boxFar)
+            return;
+        float offset = depth - glm::clamp(depth, boxNear, boxFar);
+        float radius = std::sqrt(glm::max(light.radius * light.radius - offset * offset, 0.0f));
+
+        // Project the box corners to find the tiles it covers on the screen
+        glm::vec2 minNDC(std::numeric_limits<float>::max()), maxNDC(-std::numeric_limits<float>::max());
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 point(light.center.x + ((corner & 1) ? radius : -radius),
+                            light.center.y + ((corner & 2) ? radius : -radius),
+                            (corner & 4) ? -boxFar : -boxNear, 1.0f);
+            glm::vec4 clip = P * point;
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            minNDC = glm::min(minNDC, ndc);
+            maxNDC = glm::max(maxNDC, ndc);
+        }
+        if (maxNDC.x < -1 || maxNDC.y < -1 || minNDC.x > 1 || minNDC.y > 1)
+            return;
+        glm::uvec2 grid(gridSize);
+        glm::uvec2 first = glm::clamp(glm::ivec2(glm::floor((minNDC * 0.5f + 0.5f) * glm::vec2(grid))), glm::ivec2(0), glm::ivec2(grid) - 1);
+        glm::uvec2 last = glm::clamp(glm::ivec2(glm::floor((maxNDC * 0.5f + 0.5f) * glm::vec2(grid))), glm::ivec2(0), glm::ivec2(grid) - 1);
+
+        for (uint32_t y = first.y; y <= last.y; y++)
+        {
+            for (uint32_t x = first.x; x <= last.x; x++)
+            {
+                uint32_t cluster = (slice * gridSize.y + y) * gridSize.x + x;
+                uint32_t &count = clusterCounts[cluster];
+                if (count < MAX_LIGHTS_PER_CLUSTER)
+                    clusterSlots[(size_t)cluster * MAX_LIGHTS_PER_CLUSTER + count++] = light.index;
+            }
+        }
+    }
+
+    void LightClusters::bind() const
+    {
+        GLStateCache::activeTexture(LIGHT_DATA_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        GLStateCache::activeTexture(CLUSTER_DATA_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, clusterTexture);
+        GLStateCache::activeTexture(LIGHT_INDICES_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        GLStateCache::activeTexture(0);
+    }
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../components/light.hpp"
+#include "../shader/uniform-blocks.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // Clustered forward lighting
+    // Looping over every light in every fragment gets expensive fast, so the view frustum is divided into a 3D grid
+    // of clusters (tiles on the screen and exponential slices along the depth) and every point and spot light is
+    // assigned (on the CPU) to the clusters its range touches. The fragment shader finds its cluster from its
+    // screen position and depth then only shades the lights listed in that cluster.
+    // Directional lights (and lights whose attenuation never reaches zero) affect everything, so they are "global"
+    // lights that every fragment loops over.
+    // The data is sent to the shaders using 3 buffer textures:
+    //  - light_data: 5 RGBA32F texels per light (global lights first)
+    //  - cluster_data: one RG32UI texel per cluster (offset and count of its lights in light_indices)
+    //  - light_indices: R32UI indices of the lights of every cluster
+    class LightClusters {
+    public:
+        // The maximum number of lights we send (the rest are ignored)
+        static constexpr uint32_t MAX_CLUSTERED_LIGHTS = 1024;
+        // The maximum number of lights that a single cluster can hold
+        static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+        // The number of texels used by each light in light_data
+        static constexpr uint32_t TEXELS_PER_LIGHT = 5;
+
+    private:
+        // The number of clusters on each axis (x & y split the screen, z splits the depth)
+        glm::uvec3 gridSize = {16, 9, 24};
+        // The buffers and the buffer textures that view them
+        GLuint lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+        GLuint lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+        // The largest buffer texture the driver supports (in texels)
+        GLint maxTexels = 65536;
+
+        // The view space bounding sphere of a point or spot light and the depth slices it touches
+        struct LightBounds {
+            glm::vec3 center;
+            float radius;
+            uint32_t index;              // The index of the light in light_data
+            uint32_t firstSlice, lastSlice;
+        };
+
+        // These are kept between frames to avoid reallocating them
+        std::vector<glm::vec4> lightData;
+        std::vector<LightBounds> localLights;
+        std::vector<uint32_t> clusterCounts;      // The number of lights in every cluster
+        std::vector<uint32_t> clusterSlots;       // MAX_LIGHTS_PER_CLUSTER light indices for every cluster
+        std::vector<glm::uvec2> clusterRanges;    // The offset and count of every cluster in "lightIndices"
+        std::vector<uint32_t> lightIndices;
+
+        ClustersBlock block;
+
+        // Adds the texels of a light to "lightData"
+        void pushLightData(const LightComponent* light, const glm::mat4& lightToWorld, float range);
+        // Adds the given light to every cluster of the given slice that its bounding sphere touches
+        void assignToSlice(const LightBounds& light, uint32_t slice, const glm::mat4& P);
+
+    public:
+        // Creates the buffers. The grid size can be changed using "clusters": [x, y, z] in the config
+        void initialize(const nlohmann::json& config);
+        // Deletes the buffers
+        void destroy();
+
+        // Assigns the lights to the clusters of the given perspective camera and uploads the result to the buffers
+        // V & P are the camera view and projection matrices and viewport is the viewport origin & size in pixels
+        void update(const std::vector<LightComponent*>& lights, const glm::mat4& V, const glm::mat4& P,
+                    float near, float far, glm::ivec4 viewport);
+        // Binds the buffer textures to their texture units
+        void bind() const;
+
+        // Returns the data that should be sent to the Clusters uniform block
+        const ClustersBlock& getBlock() const { return block; }
+    };
+
+}
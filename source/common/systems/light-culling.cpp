@@ -0,0 +1,162 @@
+#include "light-culling.hpp"
+#include "../ecs/entity.hpp"
+#include "../flight-recorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace our
+{
+
+    void LightCuller::update(const std::vector<LightComponent *> &sources, const glm::mat4 &VP, size_t maxLights)
+    {
+        RECORD_ZONE("LightCuller::update");
+        // Extract the 6 frustum planes from the view-projection matrix (each plane is (normal, distance) in the world space)
+        glm::mat4 T = glm::transpose(VP);
+        glm::vec4 planes[6] = {T[3] + T[0], T[3] - T[0], T[3] + T[1], T[3] - T[1], T[3] + T[2], T[3] - T[2]};
+        for (auto &plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        lights.clear();
+        globalLights.clear();
+        glm::vec2 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+        for (auto light : sources)
+        {
+            if (lights.size() >= maxLights)
+                break;
+            if (light->lightType < 0)
+                continue;
+            float range = light->getRange();
+            if (range <= 0)
+                continue;
+            // The position and direction are computed once here instead of once for every object
+            glm::mat4 lightToWorld = light->getOwner()->getLocalToWorldMatrix();
+            VisibleLight visible = {light, lightToWorld * glm::vec4(0, 0, 0, 1), lightToWorld * glm::vec4(0, -1, 0, 0), range};
+            if (std::isinf(range))
+            {
+                globalLights.push_back((uint32_t)lights.size());
+            }
+            else
+            {
+                // Skip the light if its sphere is completely behind any of the frustum planes
+                bool outside = false;
+                for (auto &plane : planes)
+                    outside |= glm::dot(glm::vec3(plane), visible.position) + plane.w < -range;
+                if (outside)
+                    continue;
+                boundsMin = glm::min(boundsMin, glm::vec2(visible.position.x, visible.position.z) - range);
+                boundsMax = glm::max(boundsMax, glm::vec2(visible.position.x, visible.position.z) + range);
+            }
+            lights.push_back(visible);
+        }
+        visitStamps.assign(lights.size(), currentStamp = 0);
+
+        // Build the grid over the local lights
+        cellStarts.clear();
+        cellLights.clear();
+        if (lights.size() == globalLights.size())
+        {
+            gridSize = glm::ivec2(0);
+            return;
+        }
+        gridOrigin = boundsMin;
+        glm::vec2 extent = boundsMax - boundsMin;
+        gridCellSize = glm::max(cellSize, glm::max(extent.x, extent.y) / MAX_GRID_SIZE);
+        gridSize = glm::clamp(glm::ivec2(glm::ceil(extent / gridCellSize)), glm::ivec2(1), glm::ivec2(MAX_GRID_SIZE));
+
+        // First count the lights of every cell, then turn the counts into offsets, then fill the cells
+        cellStarts.assign(gridSize.x * gridSize.y + 1, 0);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (uint32_t index = 0; index < lights.size(); index++)
+            {
+                const VisibleLight &light = lights[index];
+                if (std::isinf(light.range))
+                    continue;
+                glm::vec2 center(light.position.x, light.position.z);
+                glm::ivec2 first, last;
+                getCellRange(center - light.range, center + light.range, first, last);
+                for (int y = first.y; y <= last.y; y++)
+                    for (int x = first.x; x <= last.x; x++)
+                    {
+                        uint32_t cell = y * gridSize.x + x;
+                        if (pass == 0)
+                            cellStarts[cell + 1]++;
+                        else
+                            cellLights[cellStarts[cell]++] = index;
+                    }
+            }
+            if (pass == 0)
+            {
+                for (size_t cell = 1; cell < cellStarts.size(); cell++)
+                    cellStarts[cell] += cellStarts[cell - 1];
+                cellLights.resize(cellStarts.back());
+            }
+        }
+        // The fill pass advanced every start to the start of the next cell, so we shift them back
+        for (size_t cell = cellStarts.size() - 1; cell > 0; cell--)
+            cellStarts[cell] = cellStarts[cell - 1];
+        cellStarts[0] = 0;
+    }
+
+    void LightCuller::getCellRange(glm::vec2 min, glm::vec2 max, glm::ivec2 &first, glm::ivec2 &last) const
+    {
+        first = glm::clamp(glm::ivec2(glm::floor((min - gridOrigin) / gridCellSize)), glm::ivec2(0), gridSize - 1);
+        last = glm::clamp(glm::ivec2(glm::floor((max - gridOrigin) / gridCellSize)), glm::ivec2(0), gridSize - 1);
+    }
+
+    int LightCuller::query(const glm::vec3 &center, float radius, GLint *result, int maxCount) const
+    {
+        candidates.clear();
+        // The global lights affect everything, so they are always candidates
+        for (uint32_t index : globalLights)
+        {
+            const VisibleLight &light = lights[index];
+            float distance = light.light->lightType == 0 ? 0.0f : glm::max(glm::distance(light.position, center) - radius, 0.0f);
+            // The directional lights come first since they light the whole object
+            float score = light.light->lightType == 0 ? std::numeric_limits<float>::infinity() : light.light->getIntensityAt(distance);
+            candidates.emplace_back(score, index);
+        }
+        // Then we check the lights in the cells covered by the object
+        if (gridSize.x > 0)
+        {
+            glm::vec2 xz(center.x, center.z);
+            glm::ivec2 first, last;
+            getCellRange(xz - radius, xz + radius, first, last);
+            // Since the grid is clamped, an object outside it still checks the border cells (which is harmless)
+            if (++currentStamp == 0)
+            {
+                std::fill(visitStamps.begin(), visitStamps.end(), 0);
+                currentStamp = 1;
+            }
+            for (int y = first.y; y <= last.y; y++)
+                for (int x = first.x; x <= last.x; x++)
+                {
+                    uint32_t cell = y * gridSize.x + x;
+                    for (uint32_t slot = cellStarts[cell]; slot < cellStarts[cell + 1]; slot++)
+                    {
+                        uint32_t index = cellLights[slot];
+                        if (visitStamps[index] == currentStamp)
+                            continue;
+                        visitStamps[index] = currentStamp;
+                        const VisibleLight &light = lights[index];
+                        float distance = glm::max(glm::distance(light.position, center) - radius, 0.0f);
+                        if (distance > light.range)
+                            continue;
+                        candidates.emplace_back(light.light->getIntensityAt(distance), index);
+                    }
+                }
+        }
+
+        // Keep the brightest lights
+        int count = glm::min((int)candidates.size(), maxCount);
+        std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+                          [](const auto &first, const auto &second)
+                          { return first.first > second.first; });
+        for (int index = 0; index < count; index++)
+            result[index] = (GLint)candidates[index].second;
+        return count;
+    }
+
+}
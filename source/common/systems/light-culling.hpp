@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../components/light.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // Per-object light culling (used when clustered lighting is off)
+    // Once per frame, "update" drops the lights outside the view frustum, computes the world position & direction of
+    // the rest and puts the point and spot lights in a grid on the XZ plane (the maze is flat, so a 2D grid is enough).
+    // Then, for every lit object, "query" uses the grid to find the lights whose range touches the object bounds
+    // and returns the most relevant of them (the brightest at the object).
+    class LightCuller {
+    public:
+        // A light that survived the frustum culling. The index of a light in "getLights" is its index in the Lights block.
+        struct VisibleLight {
+            LightComponent* light;
+            glm::vec3 position;     // World position
+            glm::vec3 direction;    // World direction
+            float range;            // Infinity for the lights that affect everything (e.g. directional lights)
+        };
+
+    private:
+        std::vector<VisibleLight> lights;
+        std::vector<uint32_t> globalLights;     // The indices of the lights with an infinite range
+
+        // The grid covers the bounds of the local lights and every cell lists the lights whose range overlaps it
+        // The lists are packed one after the other: cell "i" owns cellLights[cellStarts[i] .. cellStarts[i + 1])
+        float cellSize = 4.0f;          // The requested cell size
+        float gridCellSize = 4.0f;      // The cell size used this frame
+        glm::vec2 gridOrigin = glm::vec2(0);
+        glm::ivec2 gridSize = glm::ivec2(0);
+        std::vector<uint32_t> cellStarts;
+        std::vector<uint32_t> cellLights;
+
+        // A light can be in many of the cells touched by a query, so we stamp the lights we already checked
+        mutable std::vector<uint32_t> visitStamps;
+        mutable uint32_t currentStamp = 0;
+        // The candidates of the current query (kept to avoid reallocating them)
+        mutable std::vector<std::pair<float, uint32_t>> candidates;
+
+        // Returns the range of cells covered by the given XZ rectangle (clamped to the grid)
+        void getCellRange(glm::vec2 min, glm::vec2 max, glm::ivec2& first, glm::ivec2& last) const;
+
+    public:
+        // The largest number of cells on each axis (the cell size is increased if the lights are spread too far)
+        static constexpr int MAX_GRID_SIZE = 64;
+
+        // Sets the side length of the grid cells (in world units)
+        void setCellSize(float size) { cellSize = glm::max(size, 0.01f); }
+
+        // Culls the lights against the view frustum of the given view-projection matrix (keeping at most "maxLights")
+        // and rebuilds the grid. This should be called once per frame before any "query".
+        void update(const std::vector<LightComponent*>& sources, const glm::mat4& VP, size_t maxLights);
+
+        // Writes the indices (in "getLights") of at most "maxCount" lights that affect the given world space sphere
+        // sorted from the most relevant to the least. Returns the number of written indices.
+        int query(const glm::vec3& center, float radius, GLint* result, int maxCount) const;
+
+        const std::vector<VisibleLight>& getLights() const { return lights; }
+    };
+
+}
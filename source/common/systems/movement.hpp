@@ -2,6 +2,7 @@
 
 #include "../ecs/world.hpp"
 #include "../components/movement.hpp"
+#include "../flight-recorder.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -19,6 +20,7 @@ namespace our
 
         // This should be called every frame to update all entities containing a MovementComponent. 
         void update(World* world, float deltaTime) {
+            RECORD_ZONE("MovementSystem::update");
             // For each entity in the world
             for(auto entity : world->getEntities()){
                 // Get the movement component if it exists
@@ -0,0 +1,232 @@
+#include "postprocess-chain.hpp"
+#include "../texture/texture-utils.hpp"
+#include "../cpu-profiler.hpp"
+#include "../frame-stats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace our
+{
+
+    void PostprocessChain::initialize(const nlohmann::json &config)
+    {
+        PROFILE_SCOPE("PostprocessChain::initialize");
+        destroy();
+        if (!config.is_array())
+            return;
+        for (const auto &item : config)
+        {
+            Effect effect;
+            effect.name = item.is_string() ? item.get<std::string>() : item.value("effect", "");
+            std::string path = EFFECTS_DIRECTORY + effect.name + ".glsl";
+            std::ifstream file(path);
+            if (!file)
+            {
+                std::cerr << "ERROR: Couldn't open postprocess effect: " << path << std::endl;
+                continue;
+            }
+            effect.source = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            // The signature of "apply" tells whether the effect samples its input or only transforms a color
+            effect.sampling = effect.source.find("apply(sampler2D") != std::string::npos;
+            if (item.is_object())
+                effect.scale = glm::clamp(item.value("scale", 1.0f), 0.01f, 1.0f);
+            if (item.is_object() && item.contains("textures"))
+                for (auto &[uniform, image] : item["textures"].items())
+                    effect.textures.emplace_back(uniform, texture_utils::loadImage(image.get<std::string>()));
+            effects.push_back(std::move(effect));
+        }
+
+        // Split the chain into passes: only a sampling effect that comes after other effects or a change of the
+        // resolution needs a new pass
+        for (size_t index = 0; index < effects.size(); index++)
+        {
+            const Effect &effect = effects[index];
+            if (passes.empty() || effect.sampling || effect.scale != passes.back().scale)
+            {
+                Pass pass;
+                pass.scale = effect.scale;
+                // Going back to the full resolution, the low resolution result is upsampled at the start of the pass
+                // But a sampling effect reads the neighbors of its pixels, so it needs the upsampled result in a texture
+                if (!passes.empty() && passes.back().scale < 1.0f && effect.scale == 1.0f)
+                {
+                    if (effect.sampling)
+                    {
+                        Pass upsamplePass;
+                        upsamplePass.upsample = true;
+                        passes.push_back(upsamplePass);
+                    }
+                    else
+                        pass.upsample = true;
+                }
+                passes.push_back(pass);
+            }
+            passes.back().effects.push_back(index);
+        }
+        // The output always has the full resolution
+        if (!passes.empty() && passes.back().scale < 1.0f)
+        {
+            Pass upsamplePass;
+            upsamplePass.upsample = true;
+            passes.push_back(upsamplePass);
+        }
+        if (std::any_of(passes.begin(), passes.end(), [](const Pass &pass){ return pass.upsample; }))
+        {
+            std::ifstream file(UPSAMPLE_PATH);
+            if (!file)
+                std::cerr << "ERROR: Couldn't open the postprocess upsample: " << UPSAMPLE_PATH << std::endl;
+            upsampleSource = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        for (auto &pass : passes)
+            pass.program = getProgram(pass);
+
+        sampler = new Sampler();
+        sampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        sampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        sampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        depthSampler = new Sampler();
+        depthSampler->set(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        depthSampler->set(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        depthSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        depthSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glGenVertexArrays(1, &vertexArray);
+        pipelineState.depthMask = false;
+    }
+
+    void PostprocessChain::destroy()
+    {
+        for (auto &effect : effects)
+            for (auto &[uniform, texture] : effect.textures)
+                delete texture;
+        effects.clear();
+        passes.clear();
+        for (auto &[key, program] : programs)
+            delete program;
+        programs.clear();
+        delete sampler;
+        delete depthSampler;
+        sampler = depthSampler = nullptr;
+        upsampleSource.clear();
+        if (vertexArray)
+        {
+            glDeleteVertexArrays(1, &vertexArray);
+            GLStateCache::forgetVertexArray(vertexArray);
+        }
+        vertexArray = 0;
+    }
+
+    ShaderProgram *PostprocessChain::getProgram(const Pass &pass)
+    {
+        const std::vector<size_t> &passEffects = pass.effects;
+        std::string key = pass.upsample ? "upsample" : "";
+        for (size_t index : passEffects)
+            key += (key.empty() ? "" : "+") + effects[index].name;
+        if (auto it = programs.find(key); it != programs.end())
+            return it->second;
+
+        // Every snippet defines "apply", so it is renamed (using a macro) to a function of its own
+        std::string source = "#version 330\n"
+                             "// Generated from the postprocess effects: " + key + "\n"
+                             "uniform sampler2D tex;\n"
+                             "in vec2 tex_coord;\n"
+                             "out vec4 frag_color;\n";
+        std::string body;
+        if (pass.upsample)
+        {
+            source += "uniform sampler2D scene_depth;\n\n" + upsampleSource + "\n";
+            body += "    vec4 color = upsample(tex, scene_depth, tex_coord);\n";
+        }
+        for (size_t i = 0; i < passEffects.size(); i++)
+        {
+            const Effect &effect = effects[passEffects[i]];
+            std::string function = "effect" + std::to_string(i);
+            source += "\n#define apply " + function + "\n" + effect.source + "\n#undef apply\n";
+            if (effect.sampling)
+                body += "    vec4 color = " + function + "(tex, tex_coord);\n";
+            else
+                body += (i == 0 && !pass.upsample ? "    vec4 color = texture(tex, tex_coord);\n" : "") + std::string("    color = ") + function + "(color, tex_coord);\n";
+        }
+        source += "\nvoid main(){\n" + body + "    frag_color = color;\n}\n";
+
+        auto program = new ShaderProgram();
+        program->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        program->attachSource(source, GL_FRAGMENT_SHADER);
+        program->link();
+        // The samplers keep their texture units, so they are set once: the input is at unit 0, then the scene depth
+        // (if the pass upsamples) and the extra textures follow it
+        program->bindSamplerUnit("tex", 0);
+        GLuint unit = 1;
+        if (pass.upsample)
+            program->bindSamplerUnit("scene_depth", unit++);
+        for (size_t index : passEffects)
+            for (auto &[uniform, texture] : effects[index].textures)
+                program->bindSamplerUnit(uniform.c_str(), unit++);
+        programs.emplace(key, program);
+        return program;
+    }
+
+    void PostprocessChain::executePass(const Pass &pass, Texture2D *input, Texture2D *depth)
+    {
+        pipelineState.setup();
+        pass.program->use();
+        GLStateCache::activeTexture(0);
+        input->bind();
+        sampler->bind(0);
+        GLuint unit = 1;
+        if (pass.upsample)
+        {
+            GLStateCache::activeTexture(unit);
+            depth->bind();
+            depthSampler->bind(unit);
+            unit++;
+        }
+        for (size_t index : pass.effects)
+            for (auto &[uniform, texture] : effects[index].textures)
+            {
+                GLStateCache::activeTexture(unit);
+                texture->bind();
+                sampler->bind(unit);
+                unit++;
+            }
+        GLStateCache::bindVertexArray(vertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        FrameStats::countDraw(1);
+    }
+
+    void PostprocessChain::addPasses(RenderGraph &graph, RenderResource input, RenderResource depth, RenderResource output, glm::ivec2 size, GPUTimers &timers, int timer)
+    {
+        for (size_t index = 0; index < passes.size(); index++)
+        {
+            const Pass &pass = passes[index];
+            bool first = index == 0, last = index + 1 == passes.size();
+            RenderResource source = input, target = output;
+            glm::ivec2 passSize = glm::max(glm::ivec2(glm::round(glm::vec2(size) * pass.scale)), glm::ivec2(1));
+            graph.addPass(
+                "Postprocess " + std::to_string(index),
+                [&](RenderGraph::PassBuilder &builder)
+                {
+                    builder.read(source);
+                    if (pass.upsample)
+                        builder.read(depth);
+                    if (last)
+                        builder.write(output);
+                    else
+                        target = builder.create("Postprocess " + std::to_string(index), {passSize, GL_RGBA8});
+                },
+                [this, index, source, depth, first, last, &timers, timer](const RenderGraph::PassResources &resources)
+                {
+                    if (first)
+                        timers.begin(timer);
+                    const Pass &pass = passes[index];
+                    executePass(pass, resources.getTexture(source), pass.upsample ? resources.getTexture(depth) : nullptr);
+                    if (last)
+                        timers.end();
+                });
+            input = target;
+        }
+    }
+
+}
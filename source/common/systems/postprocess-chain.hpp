@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../render-graph/render-graph.hpp"
+#include "../shader/shader.hpp"
+#include "../texture/sampler.hpp"
+#include "../material/pipeline-state.hpp"
+#include "../gpu-timers.hpp"
+
+#include <json/json.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace our
+{
+
+    // A chain of postprocessing effects applied one after the other to the scene color
+    // Every effect is a GLSL snippet in EFFECTS_DIRECTORY that defines an "apply" function:
+    //  - A pointwise effect (e.g. grayscale, vignette) only needs the color of its own pixel: "vec4 apply(vec4 color, vec2 uv)"
+    //  - A sampling effect (e.g. radial blur, distortion) reads other pixels of its input: "vec4 apply(sampler2D tex, vec2 uv)"
+    // Running every effect in its own fullscreen pass would read and write the whole screen once per effect, so the
+    // effects are fused: a pass starts with at most one sampling effect (or a plain read of the input) followed by all
+    // the pointwise effects after it. A new pass (drawing to a transient texture of the render graph) is only started
+    // when a sampling effect needs the result of the effects before it.
+    // The fragment shader of every pass is generated from the snippets of its effects, and the generated programs are
+    // cached by the list of their effects so a chain that changes back and forth doesn't compile them again.
+    // The uniforms of the effects fused in the same pass must have different names.
+    // Low frequency effects (e.g. radial blur, distortion) can run at a fraction of the resolution (a "scale" of 0.5 or
+    // 0.25 costs 4 or 16 times less). Such an effect gets a pass of its own (shared only with the pointwise effects of
+    // the same scale after it), and the full resolution pass after it starts with a depth-aware upsample of its result
+    // (see "bilateral-upsample.glsl") instead of a plain read, so the upsampling is fused with the pointwise effects too.
+    // The game only uses the distortion, the other effects can be added to the "postprocessChain" of the renderer config:
+    //     "postprocessChain": [{"effect": "radial-blur", "scale": 0.5}, "chromatic-aberration", "vignette", "grayscale"]
+    class PostprocessChain {
+    public:
+        // The directory of the effect snippets (an effect named "vignette" is read from "<EFFECTS_DIRECTORY>vignette.glsl")
+        static constexpr const char *EFFECTS_DIRECTORY = "assets/shaders/postprocess/effects/";
+        // The function that upsamples the result of a low resolution pass
+        static constexpr const char *UPSAMPLE_PATH = "assets/shaders/postprocess/bilateral-upsample.glsl";
+
+    private:
+        struct Effect {
+            std::string name;
+            std::string source;
+            bool sampling;
+            // The fraction of the resolution the effect runs at
+            float scale = 1.0f;
+            // The extra textures of the effect by the names of their sampler uniforms
+            std::vector<std::pair<std::string, Texture2D *>> textures;
+        };
+        struct Pass {
+            std::vector<size_t> effects;
+            float scale = 1.0f;
+            // Whether the input of the pass has a lower resolution and must be upsampled (using the scene depth)
+            bool upsample = false;
+            ShaderProgram *program = nullptr;
+        };
+        std::vector<Effect> effects;
+        std::vector<Pass> passes;
+        // The generated programs by the names of their effects (joined by "+", and starting with "upsample" if they do)
+        std::unordered_map<std::string, ShaderProgram *> programs;
+        std::string upsampleSource;
+        Sampler *sampler = nullptr;
+        // The depth is point sampled since blending the depths of an edge would make it match neither side
+        Sampler *depthSampler = nullptr;
+        GLuint vertexArray = 0;
+        // No depth testing or writing, the passes only draw a fullscreen triangle
+        PipelineState pipelineState;
+
+        // Returns the program applying the given effects (generating and compiling it if it is not cached)
+        ShaderProgram *getProgram(const Pass &pass);
+        // Draws a fullscreen triangle applying the effects of the pass to the input texture
+        void executePass(const Pass &pass, Texture2D *input, Texture2D *depth);
+
+    public:
+        // Reads the chain from the config: an array where every item is either the name of an effect
+        // or an object {"effect": name, "textures": {"sampler name": "image file", ...}, "scale": fraction of the resolution}
+        void initialize(const nlohmann::json &config);
+        void destroy();
+
+        bool isEnabled() const { return !passes.empty(); }
+        int getPassCount() const { return (int)passes.size(); }
+
+        // Adds the passes of the chain to the graph: the first one reads "input", the last one writes "output" and the
+        // ones in between draw to transient textures of the given size (scaled for the low resolution effects).
+        // "depth" is the scene depth used to upsample the low resolution results. The GPU time of all of them is measured by the given timer.
+        void addPasses(RenderGraph &graph, RenderResource input, RenderResource depth, RenderResource output, glm::ivec2 size, GPUTimers &timers, int timer);
+    };
+
+}
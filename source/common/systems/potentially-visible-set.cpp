@@ -0,0 +1,314 @@
+#include "potentially-visible-set.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../job-system.hpp"
+#include "../flight-recorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace our
+{
+
+    void PotentiallyVisibleSet::configure(const nlohmann::json &config)
+    {
+        cellSize = glm::max(config.value("cellSize", cellSize), 0.01f);
+        eyeHeight = config.value("eyeHeight", eyeHeight);
+        originsPerCell = glm::max(config.value("originsPerCell", originsPerCell), 1);
+        raysPerOrigin = glm::max(config.value("raysPerOrigin", raysPerOrigin), 4);
+    }
+
+    void PotentiallyVisibleSet::clear()
+    {
+        built = false;
+        gridSize = glm::ivec2(0);
+        occluders.clear();
+        cellOccluderStarts.clear();
+        cellOccluders.clear();
+        setStarts.clear();
+        sets.clear();
+        currentBits.clear();
+        currentCell = -1;
+        allVisible = true;
+    }
+
+    void PotentiallyVisibleSet::build(World *world)
+    {
+        PROFILE_SCOPE("PotentiallyVisibleSet::build");
+        clear();
+
+        // Find the occluders: the static opaque meshes that cross the eye height
+        glm::vec2 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+        occluderTop = std::numeric_limits<float>::max();
+        occluderBottom = -std::numeric_limits<float>::max();
+        for (auto entity : world->getEntities())
+        {
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            if (!meshRenderer || !meshRenderer->isStatic || !meshRenderer->mesh || !meshRenderer->material || meshRenderer->material->transparent)
+                continue;
+            // Transform the corners of the mesh bounding box to get the world space bounding box
+            Mesh *mesh = meshRenderer->mesh;
+            glm::mat4 M = entity->getLocalToWorldMatrix();
+            glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(-std::numeric_limits<float>::max());
+            for (int corner = 0; corner < 8; corner++)
+            {
+                glm::vec3 point = M * glm::vec4((corner & 1) ? mesh->maxX : mesh->minX,
+                                                (corner & 2) ? mesh->maxY : mesh->minY,
+                                                (corner & 4) ? mesh->maxZ : mesh->minZ, 1.0f);
+                boxMin = glm::min(boxMin, point);
+                boxMax = glm::max(boxMax, point);
+            }
+            if (boxMin.y > eyeHeight || boxMax.y < eyeHeight)
+                continue;
+            occluders.push_back(glm::vec4(boxMin.x, boxMin.z, boxMax.x, boxMax.z));
+            occluderTop = glm::min(occluderTop, boxMax.y);
+            occluderBottom = glm::max(occluderBottom, boxMin.y);
+            boundsMin = glm::min(boundsMin, glm::vec2(boxMin.x, boxMin.z));
+            boundsMax = glm::max(boundsMax, glm::vec2(boxMax.x, boxMax.z));
+        }
+        if (occluders.empty())
+            return;
+
+        // The grid covers the occluders with a margin of one cell on each side
+        gridCellSize = glm::max(cellSize, glm::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y) / (MAX_GRID_SIZE - 2));
+        gridOrigin = boundsMin - gridCellSize;
+        gridSize = glm::clamp(glm::ivec2(glm::ceil((boundsMax - boundsMin) / gridCellSize)) + 2, glm::ivec2(1), glm::ivec2(MAX_GRID_SIZE));
+        int cellCount = gridSize.x * gridSize.y;
+
+        // Register every occluder in the cells it overlaps (counting first, then filling)
+        cellOccluderStarts.assign(cellCount + 1, 0);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (uint32_t index = 0; index < occluders.size(); index++)
+            {
+                const glm::vec4 &rect = occluders[index];
+                glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor((glm::vec2(rect.x, rect.y) - gridOrigin) / gridCellSize)), glm::ivec2(0), gridSize - 1);
+                glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor((glm::vec2(rect.z, rect.w) - gridOrigin) / gridCellSize)), glm::ivec2(0), gridSize - 1);
+                for (int y = first.y; y <= last.y; y++)
+                    for (int x = first.x; x <= last.x; x++)
+                    {
+                        int cell = y * gridSize.x + x;
+                        if (pass == 0)
+                            cellOccluderStarts[cell + 1]++;
+                        else
+                            cellOccluders[cellOccluderStarts[cell]++] = index;
+                    }
+            }
+            if (pass == 0)
+            {
+                for (int cell = 1; cell <= cellCount; cell++)
+                    cellOccluderStarts[cell] += cellOccluderStarts[cell - 1];
+                cellOccluders.resize(cellOccluderStarts.back());
+            }
+        }
+        // The fill pass advanced every start to the start of the next cell, so we shift them back
+        for (int cell = cellCount; cell > 0; cell--)
+            cellOccluderStarts[cell] = cellOccluderStarts[cell - 1];
+        cellOccluderStarts[0] = 0;
+
+        // Bake every cell on the worker threads. Each cell compresses its own set, so the jobs share nothing but the inputs.
+        size_t words = (cellCount + 63) / 64;
+        std::vector<std::vector<uint8_t>> cellSets(cellCount);
+        JobSystem::parallelFor(cellCount, 8, [&](size_t begin, size_t end, unsigned)
+                               {
+            std::vector<uint64_t> bits(words);
+            for (size_t cell = begin; cell < end; cell++)
+            {
+                std::fill(bits.begin(), bits.end(), 0);
+                if (!bakeCell((int)cell, bits))
+                    continue;
+                // Compress the set by replacing the runs of zero bytes with their length
+                std::vector<uint8_t> &cellSet = cellSets[cell];
+                int byteCount = (cellCount + 7) / 8;
+                for (int index = 0; index < byteCount;)
+                {
+                    uint8_t value = (uint8_t)(bits[index >> 3] >> ((index & 7) * 8));
+                    cellSet.push_back(value);
+                    index++;
+                    if (value != 0)
+                        continue;
+                    uint8_t length = 1;
+                    while (index < byteCount && length < 255 && (uint8_t)(bits[index >> 3] >> ((index & 7) * 8)) == 0)
+                    {
+                        length++;
+                        index++;
+                    }
+                    cellSet.push_back(length);
+                }
+            } });
+
+        // Pack the sets of all the cells one after the other
+        setStarts.assign(cellCount + 1, 0);
+        for (int cell = 0; cell < cellCount; cell++)
+        {
+            setStarts[cell] = (uint32_t)sets.size();
+            sets.insert(sets.end(), cellSets[cell].begin(), cellSets[cell].end());
+        }
+        setStarts[cellCount] = (uint32_t)sets.size();
+        currentBits.assign(words, 0);
+        built = true;
+    }
+
+    int PotentiallyVisibleSet::getCell(glm::vec2 point) const
+    {
+        glm::ivec2 cell = glm::ivec2(glm::floor((point - gridOrigin) / gridCellSize));
+        if (cell.x < 0 || cell.y < 0 || cell.x >= gridSize.x || cell.y >= gridSize.y)
+            return -1;
+        return cell.y * gridSize.x + cell.x;
+    }
+
+    float PotentiallyVisibleSet::castInCell(int cell, glm::vec2 origin, glm::vec2 direction, float start) const
+    {
+        float nearest = std::numeric_limits<float>::infinity();
+        glm::vec2 inverse = 1.0f / direction;
+        for (uint32_t slot = cellOccluderStarts[cell]; slot < cellOccluderStarts[cell + 1]; slot++)
+        {
+            const glm::vec4 &rect = occluders[cellOccluders[slot]];
+            // The slab test: the ray is inside the rectangle between the largest entry and the smallest exit
+            glm::vec2 t0 = (glm::vec2(rect.x, rect.y) - origin) * inverse;
+            glm::vec2 t1 = (glm::vec2(rect.z, rect.w) - origin) * inverse;
+            glm::vec2 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+            float enter = glm::max(tMin.x, tMin.y), exit = glm::min(tMax.x, tMax.y);
+            if (exit >= glm::max(enter, start))
+                nearest = glm::min(nearest, glm::max(enter, start));
+        }
+        return nearest;
+    }
+
+    bool PotentiallyVisibleSet::bakeCell(int cell, std::vector<uint64_t> &bits) const
+    {
+        auto mark = [&](int x, int y)
+        {
+            if (x < 0 || y < 0 || x >= gridSize.x || y >= gridSize.y)
+                return;
+            int index = y * gridSize.x + x;
+            bits[index >> 6] |= uint64_t(1) << (index & 63);
+        };
+        glm::ivec2 home(cell % gridSize.x, cell / gridSize.x);
+        glm::vec2 cellMin = gridOrigin + glm::vec2(home) * gridCellSize;
+
+        // The ray origins are spread on a jittered n x n pattern inside the cell
+        int side = (int)std::ceil(std::sqrt((float)originsPerCell));
+        bool hasOrigin = false;
+        std::vector<glm::ivec2> reached;
+        for (int originIndex = 0; originIndex < side * side; originIndex++)
+        {
+            // A cheap deterministic hash gives the jitter, so the bake gives the same result every time
+            uint32_t hash = (uint32_t)(cell * 9781 + originIndex * 6271) * 2654435761u;
+            glm::vec2 jitter = glm::vec2((hash & 0xFFFF) / 65535.0f, (hash >> 16) / 65535.0f) - 0.5f;
+            glm::vec2 origin = cellMin + (glm::vec2(originIndex % side, originIndex / side) + 0.5f + jitter * 0.5f) * (gridCellSize / side);
+            // Skip the origins that are inside an occluder (the camera can't be there)
+            bool inside = false;
+            for (uint32_t slot = cellOccluderStarts[cell]; slot < cellOccluderStarts[cell + 1] && !inside; slot++)
+            {
+                const glm::vec4 &rect = occluders[cellOccluders[slot]];
+                inside = origin.x >= rect.x && origin.x <= rect.z && origin.y >= rect.y && origin.y <= rect.w;
+            }
+            if (inside)
+                continue;
+            hasOrigin = true;
+
+            for (int rayIndex = 0; rayIndex < raysPerOrigin; rayIndex++)
+            {
+                // Every origin rotates its directions a bit so that the rays of different origins fill each other's gaps
+                float angle = (rayIndex + (float)originIndex / (side * side)) * glm::two_pi<float>() / raysPerOrigin;
+                glm::vec2 direction(std::cos(angle), std::sin(angle));
+
+                // Walk through the cells along the ray (Amanatides & Woo) till it hits an occluder or leaves the grid
+                glm::ivec2 current = home;
+                glm::ivec2 step(direction.x > 0 ? 1 : -1, direction.y > 0 ? 1 : -1);
+                glm::vec2 nextBoundary = gridOrigin + glm::vec2(current + glm::max(step, glm::ivec2(0))) * gridCellSize;
+                glm::vec2 tMax, tDelta;
+                for (int axis = 0; axis < 2; axis++)
+                {
+                    bool moving = std::abs(direction[axis]) > 1e-6f;
+                    tMax[axis] = moving ? (nextBoundary[axis] - origin[axis]) / direction[axis] : std::numeric_limits<float>::infinity();
+                    tDelta[axis] = moving ? gridCellSize / std::abs(direction[axis]) : std::numeric_limits<float>::infinity();
+                }
+                // A wall can split the cell and leave the camera on the other side of it from all the origins,
+                // so the occluders only block the rays once they leave the cell (the walls inside it don't hide anything)
+                float start = glm::min(tMax.x, tMax.y);
+                while (current.x >= 0 && current.y >= 0 && current.x < gridSize.x && current.y < gridSize.y)
+                {
+                    mark(current.x, current.y);
+                    float exit = glm::min(tMax.x, tMax.y);
+                    if (current != home && castInCell(current.y * gridSize.x + current.x, origin, direction, start) <= exit)
+                        break;
+                    int axis = tMax.x < tMax.y ? 0 : 1;
+                    current[axis] += step[axis];
+                    tMax[axis] += tDelta[axis];
+                }
+            }
+        }
+        if (!hasOrigin)
+            return false;
+
+        // Sampling can miss thin slivers, so we grow the set by one cell in every direction to stay conservative
+        for (int y = 0; y < gridSize.y; y++)
+            for (int x = 0; x < gridSize.x; x++)
+            {
+                int index = y * gridSize.x + x;
+                if ((bits[index >> 6] >> (index & 63)) & 1)
+                    reached.emplace_back(x, y);
+            }
+        for (auto &point : reached)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                    mark(point.x + dx, point.y + dy);
+        return true;
+    }
+
+    void PotentiallyVisibleSet::setViewpoint(const glm::vec3 &eye)
+    {
+        RECORD_ZONE("PotentiallyVisibleSet::setViewpoint");
+        // The bake only holds while the camera is between the bottom and the top of the walls
+        int cell = (built && eye.y > occluderBottom && eye.y < occluderTop) ? getCell(glm::vec2(eye.x, eye.z)) : -1;
+        if (cell == currentCell)
+            return;
+        currentCell = cell;
+        // Outside the grid or inside a wall, we don't know what the camera sees
+        allVisible = cell < 0 || setStarts[cell] == setStarts[cell + 1];
+        if (allVisible)
+            return;
+
+        // Decompress the set of the new cell (a zero byte is followed by the number of zero bytes it stands for)
+        std::fill(currentBits.begin(), currentBits.end(), 0);
+        uint32_t position = 0;
+        for (uint32_t index = setStarts[cell]; index < setStarts[cell + 1]; index++)
+        {
+            uint8_t value = sets[index];
+            if (value == 0)
+            {
+                position += sets[++index];
+                continue;
+            }
+            currentBits[position >> 3] |= uint64_t(value) << ((position & 7) * 8);
+            position++;
+        }
+    }
+
+    bool PotentiallyVisibleSet::isVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        if (!built || allVisible)
+            return true;
+        // Anything taller than the walls could be seen over them
+        if (boxMax.y > occluderTop + 1e-3f)
+            return true;
+        glm::ivec2 first = glm::ivec2(glm::floor((glm::vec2(boxMin.x, boxMin.z) - gridOrigin) / gridCellSize));
+        glm::ivec2 last = glm::ivec2(glm::floor((glm::vec2(boxMax.x, boxMax.z) - gridOrigin) / gridCellSize));
+        // The grid covers all the occluders, so nothing blocks the view to the parts outside it
+        if (first.x < 0 || first.y < 0 || last.x >= gridSize.x || last.y >= gridSize.y)
+            return true;
+        if ((last.x - first.x + 1) * (last.y - first.y + 1) > MAX_TESTED_CELLS)
+            return true;
+        for (int y = first.y; y <= last.y; y++)
+            for (int x = first.x; x <= last.x; x++)
+            {
+                int index = y * gridSize.x + x;
+                if ((currentBits[index >> 6] >> (index & 63)) & 1)
+                    return true;
+            }
+        return false;
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // A potentially visible set (PVS) for occlusion culling in the maze
+    // At load time, the XZ plane is divided into square cells and the static opaque meshes that cross the eye height
+    // (the maze walls) become occluders. Then, from a few points in every cell, rays are cast in all directions on the
+    // plane and every cell a ray passes through before hitting an occluder is marked as visible from that cell.
+    // The rays are cast on worker threads and the visible set of every cell is stored as a compressed bitset.
+    // At runtime, the renderer looks up the cell of the camera and skips anything that only touches invisible cells.
+    // Since the bake is 2D, it only holds while the camera is between the bottom and the top of the walls and only for
+    // the objects that are lower than the walls. Anything else is always considered visible.
+    class PotentiallyVisibleSet {
+    public:
+        // The largest number of cells on each axis (the cell size is increased if the maze is bigger)
+        static constexpr int MAX_GRID_SIZE = 256;
+        // Objects covering more cells than this are not worth testing, so they are always considered visible
+        static constexpr int MAX_TESTED_CELLS = 256;
+
+    private:
+        // The bake settings (read from the "pvs" object of the renderer config)
+        float cellSize = 0.4f;          // The side length of a cell in world units
+        float eyeHeight = 0.2f;         // The height of the rays (a mesh is an occluder if it crosses this height)
+        int originsPerCell = 9;         // The number of ray origins in every cell (rounded up to a square number)
+        int raysPerOrigin = 256;        // The number of directions cast from every origin
+
+        bool built = false;
+        glm::vec2 gridOrigin = glm::vec2(0);
+        glm::ivec2 gridSize = glm::ivec2(0);
+        float gridCellSize = 0.4f;      // The cell size used by the bake (may be larger than "cellSize")
+        float occluderTop = 0;          // The lowest top of all the occluders
+        float occluderBottom = 0;       // The highest bottom of all the occluders
+
+        // The XZ rectangles of the occluders (x: min x, y: min z, z: max x, w: max z)
+        std::vector<glm::vec4> occluders;
+        // The occluders overlapping every cell (cell "i" owns cellOccluders[cellOccluderStarts[i] .. cellOccluderStarts[i + 1]))
+        std::vector<uint32_t> cellOccluderStarts;
+        std::vector<uint32_t> cellOccluders;
+
+        // The compressed visible sets. The set of cell "i" is stored in sets[setStarts[i] .. setStarts[i + 1]) as the bytes
+        // of its bitset where every run of zero bytes is replaced by a zero followed by the length of the run (at most 255)
+        // Most of the maze is hidden from any cell, so the zero runs are long and the sets become a lot smaller.
+        // A cell whose ray origins are all inside occluders has no bytes and sees everything.
+        std::vector<uint32_t> setStarts;
+        std::vector<uint8_t> sets;
+
+        // The visible set of the current camera cell (decompressed when the camera moves to another cell)
+        int currentCell = -1;
+        bool allVisible = true;
+        std::vector<uint64_t> currentBits;
+
+        // Returns the index of the cell containing the point or -1 if it is outside the grid
+        int getCell(glm::vec2 point) const;
+        // Returns the distance along the ray to the first occluder in the cell that the ray is inside of after "start"
+        // (or infinity if there is none)
+        float castInCell(int cell, glm::vec2 origin, glm::vec2 direction, float start) const;
+        // Casts the rays of a single cell and writes the cells they reach into "bits"
+        // Returns false if all the ray origins of the cell are inside occluders
+        bool bakeCell(int cell, std::vector<uint64_t>& bits) const;
+
+    public:
+        // Reads the bake settings
+        void configure(const nlohmann::json& config);
+        // Bakes the visible sets of the static opaque entities in the world
+        void build(World* world);
+        // Forgets the baked data (everything becomes visible)
+        void clear();
+        bool isBuilt() const { return built; }
+
+        // Selects the visible set of the cell containing the given camera position
+        void setViewpoint(const glm::vec3& eye);
+        // Returns false if the given world space bounding box can't be seen from the current viewpoint
+        bool isVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+        // Returns the number of cells and occluders, and the size of the visible sets in bytes with and without the
+        // compression (for statistics)
+        size_t getCellCount() const { return (size_t)gridSize.x * gridSize.y; }
+        size_t getOccluderCount() const { return occluders.size(); }
+        size_t getCompressedSize() const { return sets.size() + setStarts.size() * sizeof(uint32_t); }
+        size_t getUncompressedSize() const { return getCellCount() * ((getCellCount() + 63) / 64) * sizeof(uint64_t); }
+    };
+
+}
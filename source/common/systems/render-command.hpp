@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace our
+{
+
+    // The command only points to these, so it doesn't need their definitions
+    class Mesh;
+    class Material;
+
+    // The render command stores command that tells the renderer that it should draw
+    // the given mesh at the given localToWorld matrix using the given material
+    // The renderer will fill this struct using the mesh renderer components
+    struct RenderCommand {
+        glm::mat4 localToWorld;
+        glm::vec3 center;
+        glm::vec4 bounds; // The world space bounding sphere of the mesh (xyz: center, w: radius)
+        glm::vec3 boxMin, boxMax; // The world space bounding box of the mesh
+        int lod = 0; // The level of detail of the mesh that should be drawn
+        uint32_t id = 0; // Identifies the object from one frame to the next (the index of its entity when it was extracted)
+        Mesh* mesh;
+        Material* material;
+    };
+
+}
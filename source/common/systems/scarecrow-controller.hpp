@@ -6,6 +6,7 @@
 #include "../components/scarecrow-controller.hpp"
 
 #include "../application.hpp"
+#include "../flight-recorder.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -44,6 +45,7 @@ namespace our
 
         // This should be called every frame to update all entities containing a FreeCameraControllerComponent 
         void update(World* world, float deltaTime) {
+            RECORD_ZONE("ScareCrowControllerSystem::update");
             // First of all, we search for an entity containing both a CameraComponent and a FreeCameraControllerComponent
             // As soon as we find one, we break
             scarecrow* sc = nullptr;
@@ -0,0 +1,305 @@
+#include "software-occlusion.hpp"
+#include "../asset-loader.hpp"
+#include "../job-system.hpp"
+#include "../flight-recorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// SSE2 is always available on x86-64 (and on x86 when the compiler is told to use it), otherwise we fall back to plain loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace our
+{
+
+    void SoftwareOcclusion::configure(const nlohmann::json &config)
+    {
+        enabled = true;
+        if (config.contains("resolution"))
+            size = glm::ivec2(config["resolution"][0].get<int>(), config["resolution"][1].get<int>());
+        // The SIMD loops draw 4 pixels at a time, so the rows must be a multiple of 4 pixels
+        size = glm::max(size, glm::ivec2(4, 1));
+        size.x = (size.x + 3) & ~3;
+        occluderScale = glm::clamp(config.value("occluderScale", occluderScale), 0.0f, 1.0f);
+        occluderMeshes.clear();
+        for (const auto &name : config.value("occluders", std::vector<std::string>()))
+            if (Mesh *mesh = AssetLoader<Mesh>::get(name))
+                occluderMeshes.insert(mesh);
+
+        // Allocate the depth pyramid down to a single texel
+        levels.clear();
+        levelSizes.clear();
+        glm::ivec2 levelSize = size;
+        while (true)
+        {
+            levels.emplace_back(levelSize.x * levelSize.y, 1.0f);
+            levelSizes.push_back(levelSize);
+            if (levelSize == glm::ivec2(1))
+                break;
+            levelSize = glm::max((levelSize + 1) / 2, glm::ivec2(1));
+        }
+    }
+
+    void SoftwareOcclusion::beginFrame(const glm::mat4 &VP)
+    {
+        this->VP = VP;
+        occluderCorners.clear();
+        stats = OcclusionStats();
+        testedCount.store(0, std::memory_order_relaxed);
+        culledCount.store(0, std::memory_order_relaxed);
+    }
+
+    void SoftwareOcclusion::addOccluder(const Mesh *mesh, const glm::mat4 &M)
+    {
+        glm::vec3 center = glm::vec3(mesh->minX + mesh->maxX, mesh->minY + mesh->maxY, mesh->minZ + mesh->maxZ) * 0.5f;
+        glm::vec3 extent = glm::vec3(mesh->maxX - mesh->minX, mesh->maxY - mesh->minY, mesh->maxZ - mesh->minZ) * (0.5f * occluderScale);
+        glm::mat4 MVP = VP * M;
+        // The bits of the corner index select the min or max side on every axis (bit 0: x, bit 1: y, bit 2: z)
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 sign((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+            occluderCorners.push_back(MVP * glm::vec4(center + sign * extent, 1.0f));
+        }
+        stats.occluders++;
+    }
+
+    void SoftwareOcclusion::rasterize()
+    {
+        RECORD_ZONE("SoftwareOcclusion::rasterize");
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // The 6 faces of a box as quads of corner indices
+        static const int faces[6][4] = {{0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}};
+        triangles.clear();
+        for (size_t first = 0; first < occluderCorners.size(); first += 8)
+        {
+            const glm::vec4 *corners = &occluderCorners[first];
+            // Skip the boxes that are completely outside one of the side planes of the frustum
+            bool outside = false;
+            for (int axis = 0; axis < 2 && !outside; axis++)
+            {
+                bool allBelow = true, allAbove = true;
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    allBelow &= corners[corner][axis] < -corners[corner].w;
+                    allAbove &= corners[corner][axis] > corners[corner].w;
+                }
+                outside = allBelow || allAbove;
+            }
+            if (outside)
+                continue;
+            for (auto &face : faces)
+            {
+                setupTriangle(corners[face[0]], corners[face[1]], corners[face[2]]);
+                setupTriangle(corners[face[0]], corners[face[2]], corners[face[3]]);
+            }
+        }
+        stats.triangles = (uint32_t)triangles.size();
+
+        // Clear the depth buffer then let every thread draw whole tiles (so no two threads write to the same pixel)
+        std::fill(levels[0].begin(), levels[0].end(), 1.0f);
+        glm::ivec2 tiles = (size + glm::ivec2(TILE_WIDTH - 1, TILE_HEIGHT - 1)) / glm::ivec2(TILE_WIDTH, TILE_HEIGHT);
+        if (!triangles.empty())
+            JobSystem::parallelFor(tiles.x * tiles.y, 1, [&](size_t begin, size_t end, unsigned)
+                                   {
+                for (size_t tile = begin; tile < end; tile++)
+                    rasterizeTile((int)tile % tiles.x, (int)tile / tiles.x); });
+
+        // Build the pyramid where every texel is the farthest of the 2x2 texels below it
+        for (size_t level = 1; level < levels.size(); level++)
+        {
+            const std::vector<float> &source = levels[level - 1];
+            std::vector<float> &destination = levels[level];
+            glm::ivec2 sourceSize = levelSizes[level - 1], levelSize = levelSizes[level];
+            for (int y = 0; y < levelSize.y; y++)
+            {
+                int y0 = 2 * y, y1 = glm::min(2 * y + 1, sourceSize.y - 1);
+                for (int x = 0; x < levelSize.x; x++)
+                {
+                    int x0 = 2 * x, x1 = glm::min(2 * x + 1, sourceSize.x - 1);
+                    destination[y * levelSize.x + x] = glm::max(glm::max(source[y0 * sourceSize.x + x0], source[y0 * sourceSize.x + x1]),
+                                                                glm::max(source[y1 * sourceSize.x + x0], source[y1 * sourceSize.x + x1]));
+                }
+            }
+        }
+
+        stats.rasterizeTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void SoftwareOcclusion::setupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+    {
+        // Clip the triangle against the near plane (z + w >= 0) which may turn it into a quad
+        glm::vec4 input[3] = {a, b, c};
+        glm::vec4 clipped[4];
+        int count = 0;
+        for (int index = 0; index < 3; index++)
+        {
+            const glm::vec4 &current = input[index], &next = input[(index + 1) % 3];
+            float currentDistance = current.z + current.w, nextDistance = next.z + next.w;
+            if (currentDistance >= 0)
+                clipped[count++] = current;
+            if ((currentDistance >= 0) != (nextDistance >= 0))
+                clipped[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+        }
+        if (count < 3)
+            return;
+
+        // Go to the screen space: x & y in pixels and z as an OpenGL depth in [0, 1]
+        glm::vec3 screen[4];
+        for (int index = 0; index < count; index++)
+        {
+            glm::vec3 ndc = glm::vec3(clipped[index]) / glm::max(clipped[index].w, 1e-6f);
+            screen[index] = glm::vec3((glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2(size), ndc.z * 0.5f + 0.5f);
+        }
+        for (int index = 2; index < count; index++)
+            addTriangle(screen[0], screen[index - 1], screen[index]);
+    }
+
+    void SoftwareOcclusion::addTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::abs(area) < 1e-6f)
+            return;
+        // Make the triangle counter-clockwise so that the edge functions are positive inside it
+        glm::vec3 p[3] = {a, area > 0 ? b : c, area > 0 ? c : b};
+        area = std::abs(area);
+
+        Triangle triangle;
+        glm::vec2 min = glm::min(glm::vec2(p[0]), glm::min(glm::vec2(p[1]), glm::vec2(p[2])));
+        glm::vec2 max = glm::max(glm::vec2(p[0]), glm::max(glm::vec2(p[1]), glm::vec2(p[2])));
+        // A pixel is covered if its center (x + 0.5, y + 0.5) is inside the triangle
+        triangle.min = glm::max(glm::ivec2(glm::ceil(min - 0.5f)), glm::ivec2(0));
+        triangle.max = glm::min(glm::ivec2(glm::floor(max - 0.5f)), size - 1);
+        if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+            return;
+
+        // The functions are shifted by half a pixel so that they can be evaluated directly at the pixel indices
+        // They are also pulled inward by half a pixel so that only the pixels completely inside the triangle are drawn
+        // (otherwise an occluder covering a part of a pixel could hide an object seen through the rest of it)
+        for (int edge = 0; edge < 3; edge++)
+        {
+            const glm::vec3 &from = p[edge], &to = p[(edge + 1) % 3];
+            glm::vec3 function(from.y - to.y, to.x - from.x, from.x * to.y - from.y * to.x);
+            function.z += 0.5f * (function.x + function.y) - 0.5f * (std::abs(function.x) + std::abs(function.y));
+            triangle.edges[edge] = function;
+        }
+        // The depth is linear in the screen space, so it is a plane through the 3 vertices
+        glm::vec3 depth;
+        depth.x = ((p[1].z - p[0].z) * (p[2].y - p[0].y) - (p[2].z - p[0].z) * (p[1].y - p[0].y)) / area;
+        depth.y = ((p[2].z - p[0].z) * (p[1].x - p[0].x) - (p[1].z - p[0].z) * (p[2].x - p[0].x)) / area;
+        // For the same reason, every pixel gets the farthest depth the triangle has inside it
+        depth.z = p[0].z - depth.x * p[0].x - depth.y * p[0].y + 0.5f * (depth.x + depth.y) + 0.5f * (std::abs(depth.x) + std::abs(depth.y));
+        triangle.depth = depth;
+        triangles.push_back(triangle);
+    }
+
+    void SoftwareOcclusion::rasterizeTile(int tileX, int tileY)
+    {
+        glm::ivec2 tileMin(tileX * TILE_WIDTH, tileY * TILE_HEIGHT);
+        glm::ivec2 tileMax = glm::min(tileMin + glm::ivec2(TILE_WIDTH, TILE_HEIGHT), size) - 1;
+        float *depthBuffer = levels[0].data();
+        for (const Triangle &triangle : triangles)
+        {
+            glm::ivec2 min = glm::max(triangle.min, tileMin), max = glm::min(triangle.max, tileMax);
+            if (min.x > max.x || min.y > max.y)
+                continue;
+            // The rows are walked in groups of 4 pixels starting at a multiple of 4 (the extra pixels fail the edge tests)
+            min.x &= ~3;
+            const glm::vec3 *edges = triangle.edges;
+            const glm::vec3 &depth = triangle.depth;
+#ifdef SOFTWARE_OCCLUSION_SSE
+            const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            const __m128 zero = _mm_setzero_ps();
+            __m128 edgeX[3], depthX = _mm_set1_ps(depth.x);
+            for (int edge = 0; edge < 3; edge++)
+                edgeX[edge] = _mm_set1_ps(edges[edge].x);
+            for (int y = min.y; y <= max.y; y++)
+            {
+                float *row = depthBuffer + y * size.x;
+                __m128 rowEdge[3];
+                for (int edge = 0; edge < 3; edge++)
+                    rowEdge[edge] = _mm_set1_ps(edges[edge].y * y + edges[edge].z);
+                __m128 rowDepth = _mm_set1_ps(depth.y * y + depth.z);
+                for (int x = min.x; x <= max.x; x += 4)
+                {
+                    __m128 xs = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[0], xs), rowEdge[0]), zero);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[1], xs), rowEdge[1]), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX[2], xs), rowEdge[2]), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    // Keep the nearest depth in the covered pixels and the old depth in the rest
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, _mm_add_ps(_mm_mul_ps(depthX, xs), rowDepth));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+            }
+#else
+            for (int y = min.y; y <= max.y; y++)
+            {
+                float *row = depthBuffer + y * size.x;
+                for (int x = min.x; x <= max.x; x++)
+                {
+                    if (edges[0].x * x + edges[0].y * y + edges[0].z < 0 ||
+                        edges[1].x * x + edges[1].y * y + edges[1].z < 0 ||
+                        edges[2].x * x + edges[2].y * y + edges[2].z < 0)
+                        continue;
+                    row[x] = glm::min(row[x], depth.x * x + depth.y * y + depth.z);
+                }
+            }
+#endif
+        }
+    }
+
+    bool SoftwareOcclusion::isVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        if (!enabled)
+            return true;
+        testedCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Find the screen rectangle and the nearest depth of the box
+        glm::vec2 rectMin(std::numeric_limits<float>::max()), rectMax(-std::numeric_limits<float>::max());
+        float nearest = std::numeric_limits<float>::max();
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 clip = VP * glm::vec4((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+            // A box crossing the near plane surrounds the camera, so it can't be hidden
+            if (clip.z < -clip.w)
+                return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            rectMin = glm::min(rectMin, glm::vec2(ndc));
+            rectMax = glm::max(rectMax, glm::vec2(ndc));
+            nearest = glm::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        // The boxes outside the screen are left to the frustum culling
+        if (rectMax.x < -1 || rectMax.y < -1 || rectMin.x > 1 || rectMin.y > 1)
+            return true;
+        glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor((rectMin * 0.5f + 0.5f) * glm::vec2(size))), glm::ivec2(0), size - 1);
+        glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor((rectMax * 0.5f + 0.5f) * glm::vec2(size))), glm::ivec2(0), size - 1);
+
+        // Pick the first level where the rectangle covers at most 2x2 texels
+        size_t level = 0;
+        while (level + 1 < levels.size() && ((last.x >> level) - (first.x >> level) > 1 || (last.y >> level) - (first.y >> level) > 1))
+            level++;
+        const std::vector<float> &texels = levels[level];
+        glm::ivec2 levelSize = levelSizes[level];
+        float farthest = 0.0f;
+        for (int y = first.y >> level; y <= glm::min(last.y >> (int)level, levelSize.y - 1); y++)
+            for (int x = first.x >> level; x <= glm::min(last.x >> (int)level, levelSize.x - 1); x++)
+                farthest = glm::max(farthest, texels[y * levelSize.x + x]);
+
+        // The box is hidden if its nearest point is behind everything drawn in its rectangle
+        if (nearest > farthest)
+        {
+            culledCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+}
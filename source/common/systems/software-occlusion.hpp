@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <unordered_set>
+#include <atomic>
+#include <cstdint>
+
+namespace our
+{
+
+    // The statistics of the software occlusion culling for the last frame
+    struct OcclusionStats {
+        uint32_t occluders = 0;         // The number of occluder boxes drawn into the depth buffer
+        uint32_t triangles = 0;         // The number of triangles rasterized (after clipping)
+        uint32_t tested = 0;            // The number of bounding boxes tested against the depth pyramid
+        uint32_t culled = 0;            // The number of bounding boxes found to be hidden
+        double rasterizeTime = 0;       // The time spent drawing the occluders and building the pyramid (in milliseconds)
+    };
+
+    // Software occlusion culling using a small depth buffer drawn on the CPU
+    // Every frame, the selected occluders (e.g. the maze walls) are drawn into a low resolution depth buffer as
+    // simplified boxes that fit inside their meshes. The buffer is split into tiles that are rasterized in parallel
+    // on the worker threads (4 pixels at a time using SSE when available). A pixel is only drawn if the triangle covers
+    // all of it and it gets the farthest depth in it, so the culling never hides anything that could be seen.
+    // Then a hierarchical-Z pyramid is built where every texel holds the farthest depth of the texels below it,
+    // so a bounding box can be tested by reading at most 2x2 texels from the level where its screen rectangle is
+    // about 2 texels wide.
+    // Unlike the potentially visible set, nothing is baked, so the occluders and the objects can move freely.
+    // Everything here runs on the CPU (no OpenGL calls), so it can also be used without a window.
+    class SoftwareOcclusion {
+    public:
+        // The size of the tiles that the depth buffer is split into (every tile is rasterized by one thread)
+        static constexpr int TILE_WIDTH = 64, TILE_HEIGHT = 32;
+
+    private:
+        bool enabled = false;
+        // The size of the depth buffer (the width is rounded up to a multiple of 4 for the SIMD loops)
+        glm::ivec2 size = {256, 128};
+        // The occluder box of a mesh is its bounding box scaled by this factor around its center so that it stays inside the mesh
+        float occluderScale = 0.9f;
+        // The meshes whose entities are drawn as occluders (selected by their asset names in the config)
+        std::unordered_set<const Mesh*> occluderMeshes;
+
+        glm::mat4 VP = glm::mat4(1.0f);
+        // The 8 clip space corners of every occluder box of this frame
+        std::vector<glm::vec4> occluderCorners;
+
+        // A triangle ready to be rasterized: its edge functions (x: a, y: b, z: c for a * x + b * y + c) are positive
+        // inside the triangle and its depth is (depth.x * x + depth.y * y + depth.z) where x & y are the pixel coordinates
+        struct Triangle {
+            glm::vec3 edges[3];
+            glm::vec3 depth;
+            glm::ivec2 min, max;        // The pixel bounding box (inclusive and clamped to the buffer)
+        };
+        std::vector<Triangle> triangles;
+
+        // The depth pyramid: level 0 is the depth buffer and every other level is half the size of the one before it
+        // The depths are in [0, 1] like the OpenGL depth buffer (1 is the far plane)
+        std::vector<std::vector<float>> levels;
+        std::vector<glm::ivec2> levelSizes;
+
+        OcclusionStats stats;
+        // The boxes are tested from several threads at once (see "ForwardRenderer::extractCommands"), so they are counted atomically
+        std::atomic<uint32_t> testedCount{0}, culledCount{0};
+
+        // Clips the triangle against the near plane and adds the result to "triangles"
+        void setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+        // Adds a screen space triangle (x & y in pixels, z is the depth) to "triangles"
+        void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+        // Draws all the triangles overlapping the given tile into the depth buffer
+        void rasterizeTile(int tileX, int tileY);
+
+    public:
+        // Reads the settings from the "occlusion" object of the renderer config:
+        // "occluders": the names of the occluder meshes, "resolution": [width, height], "occluderScale": number
+        void configure(const nlohmann::json& config);
+        bool isEnabled() const { return enabled; }
+        // Returns true if the entities drawing the given mesh should be drawn as occluders
+        bool isOccluder(const Mesh* mesh) const { return occluderMeshes.count(mesh) != 0; }
+
+        // Forgets the occluders of the previous frame and sets the view-projection matrix of this one
+        void beginFrame(const glm::mat4& VP);
+        // Adds the occluder box of the given mesh drawn with the given model matrix
+        void addOccluder(const Mesh* mesh, const glm::mat4& M);
+        // Draws the occluders into the depth buffer (on the worker threads) and builds the depth pyramid
+        void rasterize();
+
+        // Returns false if the given world space bounding box is hidden behind the occluders
+        // It can be called from several threads at once (after "rasterize")
+        bool isVisible(const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+        OcclusionStats getStats() const {
+            OcclusionStats result = stats;
+            result.tested = testedCount.load(std::memory_order_relaxed);
+            result.culled = culledCount.load(std::memory_order_relaxed);
+            return result;
+        }
+        // Returns the depth buffer (row by row, the first row is the bottom of the screen) and its size
+        const std::vector<float>& getDepthBuffer() const { return levels.front(); }
+        glm::ivec2 getSize() const { return size; }
+    };
+
+}
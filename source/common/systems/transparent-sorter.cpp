@@ -0,0 +1,165 @@
+#include "transparent-sorter.hpp"
+#include "../cpu-profiler.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace our
+{
+
+    namespace
+    {
+        // Estimates how many places every command moves on average since the last frame without looking at the ranks
+        // Moving the camera doesn't change the order along "forward", only turning it does: the depth of every command
+        // changes by its drift (its depth along the turn), so a command passes the commands whose depths are closer to
+        // its own than the difference of their drifts, which is a third of the drift range on average, and every pass
+        // is one move of the insertion sort for one of the two commands
+        float coherenceMoves(size_t count, float depthRange, float driftRange)
+        {
+            if (depthRange <= 0.0f)
+                return 0.0f;
+            return count * driftRange / (6.0f * depthRange);
+        }
+    }
+
+    void TransparentSorter::sort(std::vector<RenderCommand> &commands, const glm::vec3 &eye, const glm::vec3 &forward)
+    {
+        PROFILE_SCOPE("TransparentSorter::sort");
+        size_t count = commands.size();
+        coherent = false;
+        if (count < 2)
+        {
+            hasPrevious = false;
+            return;
+        }
+
+        // The farthest command gets the key 0 and the nearest one gets 65535
+        // The depths along the turn of the camera since the last frame are measured too (see "coherenceMoves")
+        glm::vec3 turn = forward - previousForward;
+        float minDepth = FLT_MAX, maxDepth = -FLT_MAX, minDrift = FLT_MAX, maxDrift = -FLT_MAX;
+        for (const auto &command : commands)
+        {
+            float depth = glm::dot(forward, command.center);
+            minDepth = glm::min(minDepth, depth);
+            maxDepth = glm::max(maxDepth, depth);
+            float drift = glm::dot(turn, command.center);
+            minDrift = glm::min(minDrift, drift);
+            maxDrift = glm::max(maxDrift, drift);
+        }
+        float scale = maxDepth > minDepth ? 65535.0f / (maxDepth - minDepth) : 0.0f;
+        keys.resize(count);
+        for (size_t index = 0; index < count; index++)
+            keys[index] = (uint16_t)((maxDepth - glm::dot(forward, commands[index].center)) * scale);
+
+        bool stillCamera = hasPrevious && previousIds.size() == count &&
+                           glm::distance(eye, previousEye) < COHERENCE_DISTANCE &&
+                           glm::dot(forward, previousForward) > COHERENCE_COS_ANGLE;
+        if (coherenceCooldown > 0)
+            coherenceCooldown--;
+        else if (stillCamera && coherenceMoves(count, maxDepth - minDepth, maxDrift - minDrift) <= MAX_MOVES_PER_COMMAND)
+        {
+            coherent = sortCoherent(commands);
+            if (!coherent)
+                coherenceCooldown = COHERENCE_RETRY_FRAMES;
+        }
+        if (!coherent)
+            sortRadix();
+
+        // Move the commands to their sorted places and remember the order for the next frame
+        sorted.resize(count);
+        previousIds.resize(count);
+        for (size_t index = 0; index < count; index++)
+        {
+            sorted[index] = commands[order[index]];
+            previousIds[index] = sorted[index].id;
+        }
+        commands.swap(sorted);
+        previousEye = eye;
+        previousForward = forward;
+        hasPrevious = true;
+    }
+
+    bool TransparentSorter::sortCoherent(const std::vector<RenderCommand> &commands)
+    {
+        const uint32_t NONE = UINT32_MAX;
+        size_t count = commands.size();
+        for (size_t rank = 0; rank < count; rank++)
+        {
+            uint32_t id = previousIds[rank];
+            if (id >= ranks.size())
+                ranks.resize(id + 1, NONE);
+            ranks[id] = (uint32_t)rank;
+        }
+        // Every command takes the place its id had in the last frame (which fails if the ids don't match anymore)
+        // The key is packed above the command index so that the insertion sort moves both at once without indirection
+        const uint64_t EMPTY = UINT64_MAX;
+        entries.assign(count, EMPTY);
+        bool matched = true;
+        for (size_t index = 0; index < count && matched; index++)
+        {
+            uint32_t id = commands[index].id;
+            uint32_t rank = id < ranks.size() ? ranks[id] : NONE;
+            if (rank == NONE || entries[rank] != EMPTY)
+                matched = false;
+            else
+                entries[rank] = ((uint64_t)keys[index] << 32) | index;
+        }
+        // The ranks are cleared so that the ids of the next frames don't see stale ranks
+        for (uint32_t id : previousIds)
+            ranks[id] = NONE;
+        if (!matched)
+            return false;
+
+        // Insertion sort (stable) which is linear if only a few commands swapped places
+        // (only the keys are compared, so the commands at the same key keep their order)
+        size_t moves = 0, maxMoves = count * MAX_MOVES_PER_COMMAND;
+        for (size_t index = 1; index < count; index++)
+        {
+            uint64_t current = entries[index];
+            uint32_t key = (uint32_t)(current >> 32);
+            size_t position = index;
+            while (position > 0 && (uint32_t)(entries[position - 1] >> 32) > key)
+            {
+                entries[position] = entries[position - 1];
+                position--;
+                if (++moves > maxMoves)
+                    return false;
+            }
+            entries[position] = current;
+        }
+        order.resize(count);
+        for (size_t rank = 0; rank < count; rank++)
+            order[rank] = (uint32_t)entries[rank];
+        return true;
+    }
+
+    void TransparentSorter::sortRadix()
+    {
+        size_t count = keys.size();
+        order.resize(count);
+        scratch.resize(count);
+        for (size_t index = 0; index < count; index++)
+            order[index] = (uint32_t)index;
+        // The low byte first then the high byte, every pass keeps the order of the equal digits so the result is stable
+        for (int shift = 0; shift < 16; shift += 8)
+        {
+            size_t offsets[256] = {};
+            for (size_t index = 0; index < count; index++)
+                offsets[(keys[index] >> shift) & 0xFF]++;
+            size_t total = 0;
+            for (size_t &offset : offsets)
+            {
+                size_t digitCount = offset;
+                offset = total;
+                total += digitCount;
+            }
+            for (size_t index = 0; index < count; index++)
+            {
+                uint32_t command = order[index];
+                scratch[offsets[(keys[command] >> shift) & 0xFF]++] = command;
+            }
+            order.swap(scratch);
+        }
+    }
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "render-command.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace our
+{
+
+    // Sorts the transparent commands from the farthest to the nearest along the camera forward direction
+    // A comparison sort that computes the depths inside the comparisons does it O(n log n) times, so instead the depth
+    // of every command is computed once and quantized to a 16-bit key (over the depth range of the frame), then the
+    // keys are sorted by a stable LSD radix sort (two passes of 8 bits), which costs O(n).
+    // The commands at the same key keep the order they are given in, so that order must not change from one frame to
+    // the next or overlapping transparent objects at the same depth would flicker (the renderer gives them in the order
+    // of the entities whatever thread extracted them, see "ForwardRenderer::buildCommands").
+    // The order barely changes from one frame to the next when the camera moves a little, so in that case the commands
+    // are put in the order of the last frame (matched by their ids) and an insertion sort fixes the few that swapped
+    // places, which is close to O(n) and keeps the commands at the same key in the same order as the last frame.
+    // If too many commands moved (or the commands changed), it falls back to the radix sort. How many commands moved is
+    // estimated from the turn of the camera before matching the ids, so the many commands that a turning camera reorders
+    // go straight to the radix sort instead of giving up halfway through the insertion sort.
+    class TransparentSorter {
+    public:
+        // The camera movement under which the order of the last frame is reused
+        static constexpr float COHERENCE_DISTANCE = 0.5f;
+        static constexpr float COHERENCE_COS_ANGLE = 0.996f; // About 5 degrees
+        // The insertion sort isn't tried if the turn of the camera should move the commands more than this many places
+        // on average, and gives up after this many moves per command if it is tried
+        static constexpr size_t MAX_MOVES_PER_COMMAND = 2;
+        // After the insertion sort gives up, the order is too unstable to reuse for a while (e.g. the camera keeps turning)
+        static constexpr int COHERENCE_RETRY_FRAMES = 8;
+
+    private:
+        std::vector<uint16_t> keys;
+        std::vector<uint32_t> order, scratch;
+        std::vector<uint64_t> entries; // The keys and the command indices packed together (used by the insertion sort)
+        std::vector<RenderCommand> sorted;
+        // The ids of the commands of the last frame in their sorted order, and the rank of every id (indexed by the id)
+        std::vector<uint32_t> previousIds;
+        std::vector<uint32_t> ranks;
+        glm::vec3 previousEye = glm::vec3(0), previousForward = glm::vec3(0);
+        bool hasPrevious = false;
+        bool coherent = false;
+        // The number of frames to wait before trying the insertion sort again
+        int coherenceCooldown = 0;
+
+        // Orders "order" by the keys using the ranks of the last frame then an insertion sort (returns false if it gave up)
+        bool sortCoherent(const std::vector<RenderCommand>& commands);
+        // Orders "order" by the keys using a radix sort
+        void sortRadix();
+
+    public:
+        // Sorts the commands so that the farthest along "forward" comes first (the commands at the same depth keep their order)
+        void sort(std::vector<RenderCommand>& commands, const glm::vec3& eye, const glm::vec3& forward);
+        // Forgets the order of the last frame (the next sort is a radix sort)
+        void reset() { hasPrevious = false; coherenceCooldown = 0; }
+        // Returns true if the last sort reused the order of the frame before it
+        bool wasCoherent() const { return coherent; }
+    };
+
+}
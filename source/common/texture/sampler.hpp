@@ -3,6 +3,7 @@
 #include <glad/gl.h>
 #include <json/json.hpp>
 #include <glm/vec4.hpp>
+#include "../gl-state-cache.hpp"
 
 namespace our {
 
@@ -52,6 +53,7 @@ namespace our {
             In this case, the variable being pointed to is the "name" member variable of the Sampler class.
             */
             glDeleteSamplers(1, &name);
+            GLStateCache::forgetSampler(name);
          }
 
         // This method binds this sampler to the given texture unit
@@ -70,8 +72,9 @@ namespace our {
             - `textureUnit`: This argument specifies the index of the texture unit to which the sampler object should be bound.
             Texture units are used to specify which texture or textures are to be used in a shader program.
             - `name`: This argument specifies the name or identifier of the sampler object that should be bound to the specified texture unit.
+            The call goes through the state cache which skips it if the sampler is already bound to this unit.
             */
-            glBindSampler(textureUnit, name);
+            GLStateCache::bindSampler(textureUnit, name);
             
         }
 
@@ -92,7 +95,7 @@ namespace our {
             - `name`: This argument specifies the name or identifier of the sampler object that should be bound to the specified texture unit,
             here 0 means no sampler will be bound to this texture .
             */
-            glBindSampler(textureUnit, 0);
+            GLStateCache::bindSampler(textureUnit, 0);
         }
 
         // This function sets a sampler paramter where the value is of type "GLint"
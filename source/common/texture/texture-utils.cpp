@@ -1,5 +1,6 @@
 #include "texture-utils.hpp"
 #include "../mesh/mesh-utils.hpp"
+#include "../cpu-profiler.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
@@ -20,6 +21,7 @@ our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
 }
 
 our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
+    PROFILE_SCOPE("texture_utils::loadImage");
     glm::ivec2 size;
     int channels;
     //Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
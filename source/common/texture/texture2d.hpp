@@ -2,6 +2,7 @@
 
 #include <glad/gl.h>
 #include <stdio.h>
+#include "../gl-state-cache.hpp"
 
 namespace our {
 
@@ -23,6 +24,7 @@ namespace our {
             //TODO: (Req 5) Complete this function
             // glGenTextures(number of texture names to be deleted,array in which the texture names are stored)
             glDeleteTextures(1, &name);
+            GLStateCache::forgetTexture(name);
         }
 
         // Get the internal OpenGL name of the texture which is useful for use with framebuffers
@@ -30,17 +32,49 @@ namespace our {
             return name;
         }
 
+        // Returns the memory used by the texture and its mip levels in bytes
+        // It is asked from OpenGL (which binds the texture), so it shouldn't be called every frame
+        size_t getMemorySize() const {
+            bind();
+            size_t total = 0;
+            for(GLint level = 0; level < 16; level++) {
+                GLint width = 0, height = 0, compressed = 0;
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+                if(width == 0 || height == 0) break; // The level doesn't exist
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+                if(compressed) {
+                    GLint bytes = 0;
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &bytes);
+                    total += bytes;
+                    continue;
+                }
+                // The size of a pixel is the sum of the sizes of its channels (in bits)
+                const GLenum channels[] = {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+                                           GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE};
+                GLint bits = 0;
+                for(GLenum channel : channels) {
+                    GLint channelBits = 0;
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, channel, &channelBits);
+                    bits += channelBits;
+                }
+                total += (size_t)width * height * bits / 8;
+            }
+            return total;
+        }
+
         // This method binds this texture to GL_TEXTURE_2D
         void bind() const {
             //TODO: (Req 5) Complete this function
             //glBindTexture(Specifies the target to which the texture is boun,name of the texture)
-            glBindTexture(GL_TEXTURE_2D, name);
+            //It goes through the state cache which skips the call if the texture is already bound to the active unit
+            GLStateCache::bindTexture2D(name);
         }
 
         // This static method ensures that no texture is bound to GL_TEXTURE_2D
         static void unbind(){
             //TODO: (Req 5) Complete this function
-            glBindTexture(GL_TEXTURE_2D, 0);
+            GLStateCache::bindTexture2D(0);
         }
 
         Texture2D(const Texture2D&) = delete;
@@ -4,6 +4,7 @@
 #include <json/json.hpp>
 
 #include <application.hpp>
+#include <cpu-profiler.hpp>
 
 #include "states/menu-state.hpp"
 #include "states/loser-state.hpp"
@@ -18,6 +19,7 @@
 #include "states/material-test-state.hpp"
 #include "states/entity-test-state.hpp"
 #include "states/renderer-test-state.hpp"
+#include "states/stress-benchmark-state.hpp"
 
 int main(int argc, char** argv) {
     
@@ -30,6 +32,19 @@ int main(int argc, char** argv) {
     // This is useful for testing multiple configurations in a batch
     // Default: 0 where the application runs indefinitely until manually closed
     int run_for_frames = args.get<int>("f", 0);
+    // headless (-H [backend]) runs the application without a window, drawing to an offscreen framebuffer
+    // The backend can be "egl" or "osmesa" (see "headless-context.hpp"), any available backend is used if none is given
+    // This is useful for running the tests and the benchmarks on machines without a display or a GPU
+    // Default: false (a window is created)
+    bool headless = args.get<bool>("H", false);
+    std::string headless_backend = args.get<std::string>("H", "");
+    if(headless_backend == "1" || headless_backend == "true") headless_backend = "";
+    // trace (-trace=path) writes the time taken by the instrumented CPU code to a Chrome trace file (see "cpu-profiler.hpp")
+    // trace-frames (-trace-frames=first:last) selects the frames to capture (both included)
+    // This is useful for finding which part of the code causes a hitch in a given frame
+    // Default: no trace, and the frames are 1:60 if a trace is requested
+    std::string trace_path = args.get<std::string>("trace", "");
+    std::string trace_frames = args.get<std::string>("trace-frames", "1:60");
 
     // Open the config file and exit if failed
     std::ifstream file_in(config_path);
@@ -43,6 +58,29 @@ int main(int argc, char** argv) {
 
     // Create the application
     our::Application app(app_config);
+    if(headless) app.setHeadless(headless_backend);
+    if(!trace_path.empty()) {
+        // A frame number must be made of digits only (stoull would accept "-1" or "5x" and throws on anything else)
+        auto parse_frame = [](const std::string& text, uint64_t& frame) {
+            if(text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+            try {
+                frame = std::stoull(text);
+            } catch(const std::exception&) {
+                return false; // Too large
+            }
+            return true;
+        };
+        auto separator = trace_frames.find(':');
+        uint64_t first_frame = 0, last_frame = 0;
+        bool valid = parse_frame(trace_frames.substr(0, separator), first_frame);
+        if(separator == std::string::npos) last_frame = first_frame;
+        else valid = valid && parse_frame(trace_frames.substr(separator + 1), last_frame);
+        if(valid && first_frame <= last_frame) {
+            our::CPUProfiler::requestCapture(trace_path, first_frame, last_frame);
+        } else {
+            std::cerr << "Invalid trace frames: " << trace_frames << " (usage: -trace-frames=first:last), no trace will be captured" << std::endl;
+        }
+    }
     
     // Register all the states of the project in the application
     app.registerState<Menustate>("menu");
@@ -58,6 +96,7 @@ int main(int argc, char** argv) {
     app.registerState<MaterialTestState>("material-test");
     app.registerState<EntityTestState>("entity-test");
     app.registerState<RendererTestState>("renderer-test");
+    app.registerState<StressBenchmarkState>("stress-benchmark");
     // Then choose the state to run based on the option "start-scene" in the config
     if(app_config.contains(std::string{"start-scene"})){
         app.changeState(app_config["start-scene"].get<std::string>());
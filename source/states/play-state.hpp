@@ -36,6 +36,10 @@ class Playstate: public our::State {
         // Then we initialize the renderer
         auto size = getApp()->getFrameBufferSize();
         renderer.initialize(size, config["renderer"]);
+        // Now that the world is loaded, merge the static entities (e.g. the maze walls) into a few large meshes
+        renderer.buildStaticBatches(&world);
+        // And bake which parts of the maze can be seen from where (if the renderer config enables it)
+        renderer.buildVisibility(&world);
     }
 
     void onDraw(double deltaTime) override {
@@ -43,7 +47,8 @@ class Playstate: public our::State {
         movementSystem.update(&world, (float)deltaTime);
         cameraController.update(&world, (float)deltaTime);
         scController.update(&world, (float)deltaTime);
-        // And finally we use the renderer system to draw the scene
+        // And finally we use the renderer system to draw the scene (at the current size of the window)
+        renderer.resize(getApp()->getFrameBufferSize());
         renderer.render(&world);
 
         // Get a reference to the keyboard object
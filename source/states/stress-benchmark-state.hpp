@@ -0,0 +1,212 @@
+#pragma once
+
+#include <application.hpp>
+
+#include <ecs/world.hpp>
+#include <components/camera.hpp>
+#include <systems/forward-renderer.hpp>
+#include <systems/scarecrow-controller.hpp>
+#include <systems/movement.hpp>
+#include <asset-loader.hpp>
+#include <scene-generator.hpp>
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// This state measures the frame times of a scene while the camera follows a fixed path.
+// The scene is the one in the app config, or a generated maze if the scene config has a "generator" object
+// (see "scene-generator.hpp"). The "benchmark" object of the app config holds the settings of the run:
+// "frames" (the measured frames), "warmup" (the frames drawn before measuring), "path" ("orbit" flies around the
+// maze looking at its center, "walk" goes around it at eye height), "output" (the file where the results are
+// written as JSON) and "saveScene" (a file where the app config is written with the generated scene, so the same
+// scene can be run by the other states or edited by hand).
+// The camera position only depends on the frame number and the systems move by a fixed time step every frame
+// (not the time the frame took), so every run draws the same frames however fast the earlier ones were.
+class StressBenchmarkState: public our::State {
+
+    using Clock = std::chrono::steady_clock;
+    // The time the systems are moved by every frame (in seconds)
+    static constexpr float TIME_STEP = 1.0f / 60;
+
+    our::World world;
+    our::ForwardRenderer renderer;
+    our::ScareCrowControllerSystem scController;
+    our::MovementSystem movementSystem;
+    our::Entity* camera = nullptr;
+
+    // The size of the area covered by the camera path along x and z (centered at the origin)
+    glm::vec2 extent = glm::vec2(10.0f);
+    std::string path;
+    int frames = 600, warmup = 60;
+    std::string outputPath;
+
+    int frame = 0;
+    Clock::time_point lastFrame;
+    // The time between the starts of consecutive frames, and the time taken by "onDraw" (both in milliseconds)
+    std::vector<double> frameTimes, drawTimes;
+    bool reported = false;
+
+    void onInitialize() override {
+        const nlohmann::json& appConfig = getApp()->getConfig();
+        nlohmann::json scene = appConfig["scene"];
+        const nlohmann::json& benchmark = appConfig.contains("benchmark") ? appConfig["benchmark"] : nlohmann::json::object();
+        frames = std::max(benchmark.value("frames", frames), 1);
+        warmup = std::max(benchmark.value("warmup", warmup), 0);
+        path = benchmark.value("path", "orbit");
+        outputPath = benchmark.value("output", "");
+
+        // If the scene should be generated, the generated assets and world replace the ones in the config
+        if(scene.contains("generator")) {
+            our::StressSceneGenerator generator;
+            generator.configure(scene["generator"]);
+            nlohmann::json generated = generator.generate();
+            scene["assets"] = generated["assets"];
+            scene["world"] = generated["world"];
+            scene.erase("generator");
+            extent = generator.getExtent();
+            if(benchmark.contains("saveScene")) saveScene(benchmark["saveScene"].get<std::string>(), scene);
+        }
+        if(benchmark.contains("extent")) extent = benchmark["extent"].get<glm::vec2>();
+
+        if(scene.contains("assets")){
+            our::deserializeAllAssets(scene["assets"]);
+        }
+        if(scene.contains("world")){
+            world.deserialize(scene["world"]);
+        }
+        // The benchmark moves the first camera in the world
+        for(auto entity : world.getEntities()){
+            if(entity->getComponent<our::CameraComponent>()){
+                camera = entity;
+                break;
+            }
+        }
+        scController.enter(getApp());
+        renderer.initialize(getApp()->getFrameBufferSize(), scene["renderer"]);
+        renderer.buildStaticBatches(&world);
+        renderer.buildVisibility(&world);
+
+        frameTimes.reserve(frames);
+        drawTimes.reserve(frames);
+    }
+
+    // Writes the app config with the generated scene in place of the generator (and without the benchmark settings)
+    void saveScene(const std::string& filename, const nlohmann::json& scene) {
+        nlohmann::json config = getApp()->getConfig();
+        config["scene"] = scene;
+        config.erase("benchmark");
+        std::ofstream file(filename);
+        if(!file) {
+            std::cerr << "Couldn't save the generated scene to: " << filename << std::endl;
+            return;
+        }
+        file << config.dump(4) << std::endl;
+        std::cout << "Generated scene saved to: " << filename << std::endl;
+    }
+
+    // Puts the camera at its place on the path for the given fraction of the run
+    void moveCamera(float progress) {
+        if(!camera) return;
+        float angle = progress * glm::two_pi<float>();
+        glm::vec3 position, direction;
+        if(path == "walk") {
+            // Go around a circle inside the maze at eye height, looking ahead
+            glm::vec2 radius = extent * 0.3f;
+            position = glm::vec3(radius.x * glm::cos(angle), 0.2f, radius.y * glm::sin(angle));
+            direction = glm::vec3(-radius.x * glm::sin(angle), 0.0f, radius.y * glm::cos(angle));
+        } else {
+            // Fly around the maze looking at its center
+            glm::vec2 radius = extent * 0.6f;
+            position = glm::vec3(radius.x * glm::cos(angle), 0.35f * glm::max(extent.x, extent.y), radius.y * glm::sin(angle));
+            direction = -position;
+        }
+        direction = glm::normalize(direction);
+        camera->localTransform.position = position;
+        // The camera looks along its -z, so the yaw and the pitch are measured from there
+        camera->localTransform.rotation = glm::vec3(
+            glm::asin(direction.y),
+            glm::atan(-direction.x, -direction.z),
+            0.0f
+        );
+    }
+
+    void onDraw(double deltaTime) override {
+        Clock::time_point start = Clock::now();
+        if(frame > warmup) frameTimes.push_back(std::chrono::duration<double, std::milli>(start - lastFrame).count());
+        lastFrame = start;
+
+        moveCamera((float)frame / (warmup + frames));
+        movementSystem.update(&world, TIME_STEP);
+        scController.update(&world, TIME_STEP);
+        renderer.resize(getApp()->getFrameBufferSize());
+        renderer.render(&world);
+
+        if(frame >= warmup && frame < warmup + frames) drawTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        // The time of the last measured frame is known when the frame after it starts
+        if(++frame > warmup + frames) {
+            report();
+            getApp()->close();
+        }
+    }
+
+    // Returns the mean and the percentiles of the given times
+    static nlohmann::json summarize(std::vector<double> times) {
+        if(times.empty()) return nlohmann::json::object();
+        std::sort(times.begin(), times.end());
+        double sum = 0.0;
+        for(double time : times) sum += time;
+        // The nearest rank percentile
+        auto percentile = [&](double p) {
+            size_t rank = (size_t)glm::ceil(p / 100.0 * times.size());
+            return times[std::clamp(rank, (size_t)1, times.size()) - 1];
+        };
+        return {
+            {"mean", sum / times.size()},
+            {"min", times.front()},
+            {"p50", percentile(50)},
+            {"p90", percentile(90)},
+            {"p95", percentile(95)},
+            {"p99", percentile(99)},
+            {"max", times.back()}
+        };
+    }
+
+    void report() {
+        if(reported || frameTimes.empty()) return;
+        reported = true;
+        nlohmann::json frameSummary = summarize(frameTimes), drawSummary = summarize(drawTimes);
+        std::cout << "Stress benchmark (" << frameTimes.size() << " frames, " << world.getEntities().size() << " entities): "
+                  << "frame p50 " << frameSummary["p50"] << " ms, p95 " << frameSummary["p95"] << " ms, p99 "
+                  << frameSummary["p99"] << " ms, max " << frameSummary["max"] << " ms" << std::endl;
+        if(outputPath.empty()) return;
+        nlohmann::json results = {
+            {"frames", frameTimes.size()},
+            {"warmup", warmup},
+            {"path", path},
+            {"entities", world.getEntities().size()},
+            {"headless", getApp()->isHeadless()},
+            {"frameTime", frameSummary},
+            {"drawTime", drawSummary},
+            {"unit", "ms"}
+        };
+        std::ofstream file(outputPath);
+        if(!file) {
+            std::cerr << "Couldn't save the benchmark results to: " << outputPath << std::endl;
+            return;
+        }
+        file << results.dump(4) << std::endl;
+        std::cout << "Benchmark results saved to: " << outputPath << std::endl;
+    }
+
+    void onDestroy() override {
+        // If the application was closed early (e.g. by -f), the frames measured so far are reported
+        report();
+        renderer.destroy();
+        world.clear();
+        our::clearAllAssets();
+    }
+};